@@ -0,0 +1,132 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Housekeeping affinity. States with a housekeepingCpuMask confine unbound
+ * workqueues and device interrupts to those CPUs so the other cores can stay
+ * in deep idle or be parked. The masks found at init are restored by states
+ * without one. Per-CPU interrupts refuse a new affinity; they are skipped.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "plat-power-priv.h"
+
+#define WORKQUEUE_CPUMASK_PATH  "/sys/devices/virtual/workqueue/cpumask"
+#define AFFINITY_MAX_IRQS       128
+#define AFFINITY_MASK_MAX       64
+#define AFFINITY_MASK_UNKNOWN   UINT32_MAX
+
+typedef struct {
+    char path[PWRMGR_PATH_MAX];
+    char baseline[AFFINITY_MASK_MAX];
+} AffinityNode_t;
+
+/* Only touched by the worker thread, or before it is started. */
+static AffinityNode_t affinity_nodes[AFFINITY_MAX_IRQS + 1];
+static int affinity_node_count = 0;
+static uint32_t affinity_applied = 0;
+
+static void affinityAddNode(const char *path, void *context)
+{
+    (void)context;
+    if (affinity_node_count == AFFINITY_MAX_IRQS + 1) {
+        PWRMGR_LOG_WARN("Too many IRQs, ignoring '%s'", path);
+        return;
+    }
+    char current[AFFINITY_MASK_MAX];
+    AffinityNode_t *node = &affinity_nodes[affinity_node_count];
+    if (!powerShadowReadBaseline(path, node->baseline, current, sizeof(current))) {
+        return;
+    }
+    node->baseline[strcspn(node->baseline, "\n")] = '\0';
+    if (strcmp(current, node->baseline) != 0) {
+        /* Confined by a previous instance; no state mask matches, so the next one is written. */
+        affinity_applied = AFFINITY_MASK_UNKNOWN;
+    }
+    snprintf(node->path, sizeof(node->path), "%s", path);
+    affinity_node_count++;
+}
+
+/**
+ * @brief Move every node to a CPU mask, or back to its baseline for 0.
+ * @return The number of nodes that refused the mask.
+*/
+static int affinityApplyMask(uint32_t cpuMask)
+{
+    char mask[AFFINITY_MASK_MAX];
+    int refused = 0;
+    snprintf(mask, sizeof(mask), "%x", cpuMask);
+    for (int i = 0; i < affinity_node_count; i++) {
+        const char *value = (0 == cpuMask) ? affinity_nodes[i].baseline : mask;
+        if (!sysfsWriteString(affinity_nodes[i].path, value)) {
+            refused++;
+        }
+    }
+    affinity_applied = cpuMask;
+    return refused;
+}
+
+/**
+ * @brief Snapshot the workqueue and interrupt affinities.
+ * Must be called before the worker thread is started.
+*/
+void powerAffinityInit(void)
+{
+    affinity_node_count = 0;
+    affinity_applied = 0;
+    affinityAddNode(WORKQUEUE_CPUMASK_PATH, NULL);
+    sysfsGlob("/proc/irq/*/smp_affinity", affinityAddNode, NULL);
+    PWRMGR_LOG_INFO("%d affinity masks registered", affinity_node_count);
+}
+
+/**
+ * @brief Worker action: confine housekeeping to the CPUs of the target state.
+ * @param from The state being left.
+ * @param to The state being entered.
+ * @return true; interrupts that keep their affinity are not an error.
+*/
+bool powerAffinityApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to)
+{
+    (void)from;
+    uint32_t cpuMask = powerStatePolicy[to].housekeepingCpuMask;
+    if (cpuMask == affinity_applied) {
+        return true;
+    }
+    int refused = affinityApplyMask(cpuMask);
+    if (0 == cpuMask) {
+        PWRMGR_LOG_INFO("Housekeeping affinity restored, %d of %d masks refused",
+                         refused, affinity_node_count);
+    } else {
+        PWRMGR_LOG_INFO("Housekeeping on 0x%x, %d of %d masks refused",
+                         cpuMask, refused, affinity_node_count);
+    }
+    return true;
+}
+
+/**
+ * @brief Restore the affinities found at init.
+ * Must be called after the worker thread has been joined.
+*/
+void powerAffinityTerm(void)
+{
+    if (0 != affinity_applied) {
+        affinityApplyMask(0);
+    }
+}
@@ -0,0 +1,261 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Scheduled wake alarms. Alarms are kept sorted by wake time; the earliest
+ * one is programmed into the RTC wakealarm while the timer wakeup source is
+ * enabled, so a suspended box is woken by the hardware. While the box is in
+ * software standby the worker wakes up for the same deadline instead.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "plat-power-priv.h"
+
+#define RTC_WAKEALARM_PATH "/sys/class/rtc/rtc0/wakealarm"
+
+typedef struct {
+    PWRMgr_WakeupAlarmId_t id;
+    time_t wakeTime;
+} WakeupAlarm_t;
+
+/* Sorted by wakeTime, earliest first. Guarded by alarm_mutex. */
+static pthread_mutex_t alarm_mutex = PTHREAD_MUTEX_INITIALIZER;
+static WakeupAlarm_t alarm_queue[PWRMGR_WAKEUP_ALARM_MAX];
+static int alarm_count = 0;
+static PWRMgr_WakeupAlarmId_t alarm_next_id = 1;
+static time_t alarm_programmed = 0;
+/* Pre-wake time; wakes the kernel but is not a client alarm. */
+static time_t alarm_prewake = 0;
+
+/**
+ * @brief Program the RTC with the head of the queue, or clear it.
+ * The kernel refuses to overwrite a pending alarm, so it is cleared first.
+ * Call with alarm_mutex held.
+*/
+static void alarmProgramRtc(void)
+{
+    time_t wanted = (alarm_count > 0) ? alarm_queue[0].wakeTime : 0;
+    if (0 != alarm_prewake && (0 == wanted || alarm_prewake < wanted)) {
+        wanted = alarm_prewake;
+    }
+    if (!powerWakeupIsEnabled(PWRMGR_WAKEUPSRC_TIMER)) {
+        wanted = 0;
+    }
+    if (wanted == alarm_programmed) {
+        return;
+    }
+    if (!sysfsWriteString(RTC_WAKEALARM_PATH, "0")) {
+        PWRMGR_LOG_ERRNO("Failed to clear RTC wakealarm");
+        return;
+    }
+    alarm_programmed = 0;
+    if (wanted != 0) {
+        if (!sysfsWriteLong(RTC_WAKEALARM_PATH, (long)wanted)) {
+            PWRMGR_LOG_ERRNO("Failed to set RTC wakealarm");
+            return;
+        }
+        alarm_programmed = wanted;
+        PWRMGR_LOG_INFO("RTC wakealarm set to %ld", (long)wanted);
+    }
+}
+
+/**
+ * @brief Reset the alarm queue.
+ * Must be called after powerWakeupInit().
+*/
+void powerAlarmInit(void)
+{
+    pthread_mutex_lock(&alarm_mutex);
+    alarm_count = 0;
+    alarm_prewake = 0;
+    long pending = 0;
+    /* An alarm left behind by a previous instance is no longer tracked; drop it. */
+    alarm_programmed = (sysfsReadLong(RTC_WAKEALARM_PATH, &pending) && pending > 0) ? (time_t)pending : 0;
+    alarmProgramRtc();
+    pthread_mutex_unlock(&alarm_mutex);
+}
+
+/**
+ * @brief Drop all alarms and clear the RTC.
+*/
+void powerAlarmTerm(void)
+{
+    pthread_mutex_lock(&alarm_mutex);
+    alarm_count = 0;
+    alarm_prewake = 0;
+    alarmProgramRtc();
+    pthread_mutex_unlock(&alarm_mutex);
+}
+
+/**
+ * @brief Re-evaluate the RTC programming, e.g. after the timer source was toggled.
+*/
+void powerAlarmSync(void)
+{
+    pthread_mutex_lock(&alarm_mutex);
+    alarmProgramRtc();
+    pthread_mutex_unlock(&alarm_mutex);
+}
+
+/**
+ * @brief Let the RTC also wake the kernel for a pre-wake.
+ * @param wakeTime Seconds since the epoch, 0 for none.
+*/
+void powerAlarmSetPrewake(time_t wakeTime)
+{
+    pthread_mutex_lock(&alarm_mutex);
+    alarm_prewake = wakeTime;
+    alarmProgramRtc();
+    pthread_mutex_unlock(&alarm_mutex);
+}
+
+/**
+ * @brief Get the worker deadline of the earliest alarm.
+ * The wall clock time is converted on every call, so clock steps are picked
+ * up the next time the worker wakes.
+ * @return The deadline in monotonic ms, 0 if no alarm is queued.
+*/
+uint64_t powerAlarmNextDeadline(void)
+{
+    pthread_mutex_lock(&alarm_mutex);
+    time_t wakeTime = (alarm_count > 0) ? alarm_queue[0].wakeTime : 0;
+    pthread_mutex_unlock(&alarm_mutex);
+    if (0 == wakeTime) {
+        return 0;
+    }
+    time_t now = time(NULL);
+    uint64_t remainingMs = (wakeTime > now) ? (uint64_t)(wakeTime - now) * 1000ULL : 0;
+    return monotonicTimeMs() + remainingMs;
+}
+
+/**
+ * @brief Pop every alarm whose wake time has passed.
+ * @return true if at least one alarm expired.
+*/
+bool powerAlarmExpire(void)
+{
+    time_t now = time(NULL);
+    int expired = 0;
+    pthread_mutex_lock(&alarm_mutex);
+    while (expired < alarm_count && alarm_queue[expired].wakeTime <= now) {
+        PWRMGR_LOG_INFO("Alarm %u expired", alarm_queue[expired].id);
+        expired++;
+    }
+    if (expired > 0) {
+        memmove(&alarm_queue[0], &alarm_queue[expired], (size_t)(alarm_count - expired) * sizeof(alarm_queue[0]));
+        alarm_count -= expired;
+        /* The RTC alarm has fired or is stale; arm the next one. */
+        alarm_programmed = (alarm_programmed <= now) ? 0 : alarm_programmed;
+        alarmProgramRtc();
+    }
+    pthread_mutex_unlock(&alarm_mutex);
+    return expired > 0;
+}
+
+/**
+ * @brief Queues a scheduled wake.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_AddWakeupAlarm(time_t wakeTime, PWRMgr_WakeupAlarmId_t *alarmId)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (NULL == alarmId || wakeTime <= time(NULL)) {
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    if (pthread_mutex_lock(&alarm_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_SET_FAILURE;
+    }
+    if (alarm_count == PWRMGR_WAKEUP_ALARM_MAX) {
+        pthread_mutex_unlock(&alarm_mutex);
+        PWRMGR_LOG_ERROR("Alarm queue is full");
+        return PWRMGR_SET_FAILURE;
+    }
+    int index = alarm_count;
+    while (index > 0 && alarm_queue[index - 1].wakeTime > wakeTime) {
+        alarm_queue[index] = alarm_queue[index - 1];
+        index--;
+    }
+    alarm_queue[index].id = alarm_next_id++;
+    alarm_queue[index].wakeTime = wakeTime;
+    alarm_next_id = (0 == alarm_next_id) ? 1 : alarm_next_id;
+    alarm_count++;
+    *alarmId = alarm_queue[index].id;
+    alarmProgramRtc();
+    pthread_mutex_unlock(&alarm_mutex);
+
+    if (0 == index) {
+        /* New earliest deadline for the worker. */
+        powerMgrWakeWorker();
+    }
+    return PWRMGR_SUCCESS;
+}
+
+/**
+ * @brief Cancels a queued wakeup alarm.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_RemoveWakeupAlarm(PWRMgr_WakeupAlarmId_t alarmId)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (pthread_mutex_lock(&alarm_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_SET_FAILURE;
+    }
+    for (int index = 0; index < alarm_count; index++) {
+        if (alarm_queue[index].id != alarmId) {
+            continue;
+        }
+        memmove(&alarm_queue[index], &alarm_queue[index + 1], (size_t)(alarm_count - index - 1) * sizeof(alarm_queue[0]));
+        alarm_count--;
+        alarmProgramRtc();
+        pthread_mutex_unlock(&alarm_mutex);
+        return PWRMGR_SUCCESS;
+    }
+    pthread_mutex_unlock(&alarm_mutex);
+    return PWRMGR_INVALID_ARGUMENT;
+}
+
+/**
+ * @brief Gets the earliest queued wakeup alarm.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_GetNextWakeupAlarm(time_t *wakeTime)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (NULL == wakeTime) {
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    if (pthread_mutex_lock(&alarm_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_GET_FAILURE;
+    }
+    *wakeTime = (alarm_count > 0) ? alarm_queue[0].wakeTime : 0;
+    pthread_mutex_unlock(&alarm_mutex);
+    return PWRMGR_SUCCESS;
+}
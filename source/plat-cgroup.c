@@ -0,0 +1,179 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * cgroup v2 CPU policies. Every knob named by any state of the policy table
+ * is registered at init together with its baseline value. On a transition
+ * each knob moves to the value of the new state, or back to its baseline if
+ * the state does not name it. The pass is all or nothing: if a write fails,
+ * the knobs already written in the same pass are rolled back.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "plat-power-priv.h"
+
+#define CGROUP_MAX_KNOBS        32
+#define CGROUP_VALUE_MAX        64
+
+typedef struct {
+    char path[PWRMGR_PATH_MAX];
+    char baseline[CGROUP_VALUE_MAX];
+    char applied[CGROUP_VALUE_MAX];
+} CgroupKnob_t;
+
+/* Only touched by the worker thread, or before it is started. */
+static CgroupKnob_t cgroup_knobs[CGROUP_MAX_KNOBS];
+static int cgroup_knob_count = 0;
+
+static void cgroupKnobPath(const CgroupSetting_t *setting, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%s", setting->cgroup, setting->file);
+}
+
+static CgroupKnob_t *cgroupFindKnob(const char *path)
+{
+    for (int i = 0; i < cgroup_knob_count; i++) {
+        if (strcmp(cgroup_knobs[i].path, path) == 0) {
+            return &cgroup_knobs[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Register every knob of the policy table and snapshot its baseline.
+ * Knobs of missing cgroups are skipped. Must be called before the worker thread is started.
+*/
+void powerCgroupInit(void)
+{
+    cgroup_knob_count = 0;
+    for (int state = 0; state < PWRMGR_POWERSTATE_MAX; state++) {
+        const CgroupSetting_t *setting = powerStatePolicy[state].cgroupSettings;
+        for (; NULL != setting && NULL != setting->cgroup; setting++) {
+            char path[PWRMGR_PATH_MAX];
+            cgroupKnobPath(setting, path, sizeof(path));
+            if (NULL != cgroupFindKnob(path)) {
+                continue;
+            }
+            if (cgroup_knob_count == CGROUP_MAX_KNOBS) {
+                PWRMGR_LOG_WARN("Too many cgroup knobs, ignoring '%s'", path);
+                continue;
+            }
+            CgroupKnob_t *knob = &cgroup_knobs[cgroup_knob_count];
+            if (!powerShadowReadBaseline(path, knob->baseline, knob->applied, sizeof(knob->baseline))) {
+                PWRMGR_LOG_INFO("'%s' not available, skipping", path);
+                continue;
+            }
+            snprintf(knob->path, sizeof(knob->path), "%s", path);
+            cgroup_knob_count++;
+        }
+    }
+    PWRMGR_LOG_INFO("%d cgroup knobs registered", cgroup_knob_count);
+}
+
+/**
+ * @brief Get the value a state wants for a knob.
+ * @return The configured value, or the baseline if the state does not name the knob.
+*/
+static const char *cgroupTargetValue(const CgroupKnob_t *knob, PWRMgr_PowerState_t state)
+{
+    const CgroupSetting_t *setting = powerStatePolicy[state].cgroupSettings;
+    for (; NULL != setting && NULL != setting->cgroup; setting++) {
+        char path[PWRMGR_PATH_MAX];
+        cgroupKnobPath(setting, path, sizeof(path));
+        if (strcmp(knob->path, path) == 0) {
+            return setting->value;
+        }
+    }
+    return knob->baseline;
+}
+
+/**
+ * @brief Move every registered knob to the given state, all or nothing.
+ * @return true if successful, false if the pass was rolled back.
+*/
+static bool cgroupApplyState(PWRMgr_PowerState_t state)
+{
+    char previous[CGROUP_MAX_KNOBS][CGROUP_VALUE_MAX];
+    bool written[CGROUP_MAX_KNOBS] = {false};
+    int failed = -1;
+
+    for (int i = 0; i < cgroup_knob_count && failed < 0; i++) {
+        CgroupKnob_t *knob = &cgroup_knobs[i];
+        const char *target = cgroupTargetValue(knob, state);
+        if (strcmp(knob->applied, target) == 0) {
+            continue;
+        }
+        snprintf(previous[i], sizeof(previous[i]), "%s", knob->applied);
+        if (!sysfsWriteString(knob->path, target)) {
+            PWRMGR_LOG_ERRNO("'%s' <- '%s' failed, rolling back", knob->path, target);
+            failed = i;
+            break;
+        }
+        snprintf(knob->applied, sizeof(knob->applied), "%s", target);
+        written[i] = true;
+    }
+    if (failed < 0) {
+        return true;
+    }
+    for (int i = failed - 1; i >= 0; i--) {
+        CgroupKnob_t *knob = &cgroup_knobs[i];
+        if (!written[i]) {
+            continue;
+        }
+        if (sysfsWriteString(knob->path, previous[i])) {
+            snprintf(knob->applied, sizeof(knob->applied), "%s", previous[i]);
+        } else {
+            PWRMGR_LOG_ERRNO("Failed to roll back cgroup knob");
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Worker action: apply the cgroup v2 settings of the target state.
+ * @param from The state being left.
+ * @param to The state being entered.
+ * @return true if successful, false if the settings were rolled back.
+*/
+bool powerCgroupApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to)
+{
+    (void)from;
+    return cgroupApplyState(to);
+}
+
+/**
+ * @brief Restore every registered knob to its baseline.
+ * Must be called after the worker thread has been joined.
+*/
+void powerCgroupTerm(void)
+{
+    for (int i = 0; i < cgroup_knob_count; i++) {
+        CgroupKnob_t *knob = &cgroup_knobs[i];
+        if (strcmp(knob->applied, knob->baseline) == 0) {
+            continue;
+        }
+        if (sysfsWriteString(knob->path, knob->baseline)) {
+            memcpy(knob->applied, knob->baseline, sizeof(knob->applied));
+        } else {
+            PWRMGR_LOG_ERRNO("Failed to restore cgroup knob");
+        }
+    }
+}
@@ -0,0 +1,251 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * CPU core parking. Cores outside the online mask of a state are taken
+ * offline one by one on entry; on resume all parked cores are brought back
+ * in parallel, one thread per core, and the latency is recorded.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "plat-power-priv.h"
+
+#define CPU_PRESENT_PATH        "/sys/devices/system/cpu/present"
+#define CPU_ONLINE_PATH_FORMAT  "/sys/devices/system/cpu/cpu%d/online"
+
+typedef struct {
+    int cpu;
+    bool success;
+    uint64_t latencyUs;
+} CpuOnlineJob_t;
+
+static pthread_mutex_t hotplug_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int cpu_count = 0;
+static uint32_t present_mask = 0;
+static uint32_t hotpluggable_mask = 0;
+static uint32_t parked_mask = 0;
+static PWRMgr_CpuHotplugStats_t hotplug_stats;
+
+/**
+ * @brief Parse the "0-3" style list in /sys/devices/system/cpu/present.
+*/
+static uint32_t cpuReadPresentMask(void)
+{
+    char buffer[64] = {0};
+    uint32_t mask = 0;
+    if (!sysfsReadString(CPU_PRESENT_PATH, buffer, sizeof(buffer))) {
+        return 0;
+    }
+    char *cursor = buffer;
+    while (*cursor != '\0') {
+        char *end = NULL;
+        long first = strtol(cursor, &end, 10);
+        long last = first;
+        if (end == cursor) {
+            break;
+        }
+        if (*end == '-') {
+            cursor = end + 1;
+            last = strtol(cursor, &end, 10);
+        }
+        for (long cpu = first; cpu <= last && cpu < PWRMGR_MAX_CPUS; cpu++) {
+            mask |= (1U << cpu);
+        }
+        cursor = (*end == ',') ? end + 1 : end;
+    }
+    return mask;
+}
+
+/**
+ * @brief Discover the present and hotpluggable CPUs.
+ * Must be called before the worker thread is started.
+*/
+void powerCpuHotplugInit(void)
+{
+    pthread_mutex_lock(&hotplug_mutex);
+    present_mask = cpuReadPresentMask();
+    hotpluggable_mask = 0;
+    parked_mask = 0;
+    cpu_count = 0;
+    memset(&hotplug_stats, 0, sizeof(hotplug_stats));
+    for (int cpu = 0; cpu < PWRMGR_MAX_CPUS; cpu++) {
+        char path[PWRMGR_PATH_MAX];
+        long online = 0;
+        if (!(present_mask & (1U << cpu))) {
+            continue;
+        }
+        cpu_count = cpu + 1;
+        snprintf(path, sizeof(path), CPU_ONLINE_PATH_FORMAT, cpu);
+        /* cpu0 usually has no online attribute and can never be parked. */
+        if (sysfsReadLong(path, &online)) {
+            hotpluggable_mask |= (1U << cpu);
+            if (0 == online) {
+                parked_mask |= (1U << cpu);
+            }
+        }
+    }
+    hotplug_stats.onlineMask = present_mask & ~parked_mask;
+    pthread_mutex_unlock(&hotplug_mutex);
+    PWRMGR_LOG_INFO("present 0x%x hotpluggable 0x%x", present_mask, hotpluggable_mask);
+}
+
+static void *cpuOnlineThread(void *arg)
+{
+    CpuOnlineJob_t *job = (CpuOnlineJob_t *)arg;
+    char path[PWRMGR_PATH_MAX];
+    uint64_t start = monotonicTimeUs();
+    snprintf(path, sizeof(path), CPU_ONLINE_PATH_FORMAT, job->cpu);
+    job->success = sysfsWriteString(path, "1");
+    job->latencyUs = monotonicTimeUs() - start;
+    return NULL;
+}
+
+/**
+ * @brief Bring all CPUs in the mask online in parallel.
+ * @return The mask of CPUs that failed to come online.
+*/
+static uint32_t cpuOnlineParallel(uint32_t mask)
+{
+    CpuOnlineJob_t jobs[PWRMGR_MAX_CPUS];
+    pthread_t threads[PWRMGR_MAX_CPUS];
+    bool started[PWRMGR_MAX_CPUS] = {false};
+    uint32_t failed = 0;
+    uint64_t slowest = 0;
+    uint64_t start = monotonicTimeUs();
+
+    for (int cpu = 0; cpu < cpu_count; cpu++) {
+        if (!(mask & (1U << cpu))) {
+            continue;
+        }
+        jobs[cpu].cpu = cpu;
+        jobs[cpu].success = false;
+        jobs[cpu].latencyUs = 0;
+        if (pthread_create(&threads[cpu], NULL, cpuOnlineThread, &jobs[cpu]) == 0) {
+            started[cpu] = true;
+        } else {
+            /* Fall back to bringing this core up inline. */
+            cpuOnlineThread(&jobs[cpu]);
+        }
+    }
+    for (int cpu = 0; cpu < cpu_count; cpu++) {
+        if (!(mask & (1U << cpu))) {
+            continue;
+        }
+        if (started[cpu]) {
+            pthread_join(threads[cpu], NULL);
+        }
+        if (!jobs[cpu].success) {
+            PWRMGR_LOG_ERROR("Failed to online cpu%d", cpu);
+            failed |= (1U << cpu);
+        }
+        slowest = (jobs[cpu].latencyUs > slowest) ? jobs[cpu].latencyUs : slowest;
+    }
+    hotplug_stats.lastUnparkUs = (uint32_t)(monotonicTimeUs() - start);
+    hotplug_stats.maxCpuUnparkUs = (uint32_t)slowest;
+    return failed;
+}
+
+/**
+ * @brief Worker action: apply the online CPU mask of the target state.
+ * Offlining runs from the highest CPU down; onlining runs in parallel.
+ * @param from The state being left.
+ * @param to The state being entered.
+ * @return true if every CPU reached its requested online state.
+*/
+bool powerCpuHotplugApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to)
+{
+    (void)from;
+    uint32_t wanted = powerStatePolicy[to].onlineCpuMask;
+    bool success = true;
+
+    pthread_mutex_lock(&hotplug_mutex);
+    if (0 == wanted) {
+        wanted = present_mask;
+    }
+    uint32_t toPark = hotpluggable_mask & ~parked_mask & ~wanted;
+    uint32_t toUnpark = parked_mask & wanted;
+
+    if (toUnpark) {
+        uint32_t failed = cpuOnlineParallel(toUnpark);
+        parked_mask &= ~(toUnpark & ~failed);
+        success = (0 == failed);
+        PWRMGR_LOG_INFO("Onlined 0x%x in %u us (slowest cpu %u us)",
+                         toUnpark & ~failed, hotplug_stats.lastUnparkUs, hotplug_stats.maxCpuUnparkUs);
+    }
+    if (toPark) {
+        uint64_t start = monotonicTimeUs();
+        for (int cpu = cpu_count - 1; cpu >= 0; cpu--) {
+            char path[PWRMGR_PATH_MAX];
+            if (!(toPark & (1U << cpu))) {
+                continue;
+            }
+            snprintf(path, sizeof(path), CPU_ONLINE_PATH_FORMAT, cpu);
+            if (sysfsWriteString(path, "0")) {
+                parked_mask |= (1U << cpu);
+            } else {
+                PWRMGR_LOG_ERRNO("Failed to offline cpu");
+                success = false;
+            }
+        }
+        hotplug_stats.lastParkUs = (uint32_t)(monotonicTimeUs() - start);
+        hotplug_stats.parkCount++;
+        PWRMGR_LOG_INFO("Parked 0x%x in %u us", toPark & parked_mask, hotplug_stats.lastParkUs);
+    }
+    hotplug_stats.onlineMask = present_mask & ~parked_mask;
+    pthread_mutex_unlock(&hotplug_mutex);
+    return success;
+}
+
+/**
+ * @brief Bring every parked CPU back online.
+ * Must be called after the worker thread has been joined.
+*/
+void powerCpuHotplugTerm(void)
+{
+    pthread_mutex_lock(&hotplug_mutex);
+    if (parked_mask) {
+        parked_mask &= cpuOnlineParallel(parked_mask);
+    }
+    hotplug_stats.onlineMask = present_mask & ~parked_mask;
+    pthread_mutex_unlock(&hotplug_mutex);
+}
+
+/**
+ * @brief Gets the CPU parking statistics.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_GetCpuHotplugStats(PWRMgr_CpuHotplugStats_t *stats)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (NULL == stats) {
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    if (pthread_mutex_lock(&hotplug_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_GET_FAILURE;
+    }
+    *stats = hotplug_stats;
+    pthread_mutex_unlock(&hotplug_mutex);
+    return PWRMGR_SUCCESS;
+}
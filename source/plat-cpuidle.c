@@ -0,0 +1,216 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * cpuidle state management. Each power state selects which idle states are
+ * disabled on top of the ones the platform disabled itself, and an optional
+ * wakeup latency bound that is held through
+ * /dev/cpu_dma_latency by the QoS aggregator. Residency counters are
+ * snapshotted on every transition so the time spent in each idle state
+ * since the last power state change can be reported.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "plat-power-priv.h"
+
+#define CPUIDLE_STATE_PATH_FORMAT "/sys/devices/system/cpu/cpu%d/cpuidle/state%d/%s"
+
+static pthread_mutex_t cpuidle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int cpuidle_cpu_count = 0;
+static int cpuidle_state_count = 0;
+static char cpuidle_names[PWRMGR_CPUIDLE_MAX_STATES][16];
+static uint32_t baseline_disable_mask[PWRMGR_MAX_CPUS];
+static uint32_t applied_disable_mask[PWRMGR_MAX_CPUS];
+static uint64_t transition_time_us[PWRMGR_CPUIDLE_MAX_STATES];
+
+static bool cpuidleReadAttr(int cpu, int state, const char *attr, char *value, size_t size)
+{
+    char path[PWRMGR_PATH_MAX];
+    snprintf(path, sizeof(path), CPUIDLE_STATE_PATH_FORMAT, cpu, state, attr);
+    return sysfsReadString(path, value, size);
+}
+
+static bool cpuidleReadCounter(int cpu, int state, const char *attr, uint64_t *value)
+{
+    char buffer[32] = {0};
+    if (!cpuidleReadAttr(cpu, state, attr, buffer, sizeof(buffer))) {
+        return false;
+    }
+    *value = strtoull(buffer, NULL, 10);
+    return true;
+}
+
+/**
+ * @brief Sum a residency counter over all CPUs that currently expose it.
+*/
+static uint64_t cpuidleSumCounter(int state, const char *attr)
+{
+    uint64_t total = 0;
+    for (int cpu = 0; cpu < cpuidle_cpu_count; cpu++) {
+        uint64_t value = 0;
+        if (cpuidleReadCounter(cpu, state, attr, &value)) {
+            total += value;
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief Write the disable flags of a CPU that differ from a mask.
+ * Called with cpuidle_mutex held.
+ * @return false if cpu0 refused a write.
+*/
+static bool cpuidleWriteMask(int cpu, uint32_t wanted)
+{
+    uint32_t changed = (applied_disable_mask[cpu] ^ wanted) & ((1U << cpuidle_state_count) - 1);
+    bool success = true;
+    for (int state = 0; state < cpuidle_state_count; state++) {
+        char path[PWRMGR_PATH_MAX];
+        if (!(changed & (1U << state))) {
+            continue;
+        }
+        snprintf(path, sizeof(path), CPUIDLE_STATE_PATH_FORMAT, cpu, state, "disable");
+        if (sysfsWriteString(path, (wanted & (1U << state)) ? "1" : "0")) {
+            applied_disable_mask[cpu] ^= (1U << state);
+        } else if (cpu == 0) {
+            /* Parked cores may refuse the write; they are caught up on the next transition. */
+            PWRMGR_LOG_ERRNO("Failed to write cpuidle disable");
+            success = false;
+        }
+    }
+    return success;
+}
+
+/**
+ * @brief Discover the idle states and snapshot their disable flags.
+ * Must be called before the worker thread is started.
+*/
+void powerCpuidleInit(void)
+{
+    pthread_mutex_lock(&cpuidle_mutex);
+    cpuidle_cpu_count = 0;
+    cpuidle_state_count = 0;
+    memset(baseline_disable_mask, 0, sizeof(baseline_disable_mask));
+    memset(applied_disable_mask, 0, sizeof(applied_disable_mask));
+    for (int state = 0; state < PWRMGR_CPUIDLE_MAX_STATES; state++) {
+        if (!cpuidleReadAttr(0, state, "name", cpuidle_names[state], sizeof(cpuidle_names[state]))) {
+            break;
+        }
+        cpuidle_state_count = state + 1;
+    }
+    for (int cpu = 0; cpu < PWRMGR_MAX_CPUS; cpu++) {
+        for (int state = 0; state < cpuidle_state_count; state++) {
+            char path[PWRMGR_PATH_MAX];
+            char baseline[8] = {0};
+            char current[8] = {0};
+            snprintf(path, sizeof(path), CPUIDLE_STATE_PATH_FORMAT, cpu, state, "disable");
+            if (!powerShadowReadBaseline(path, baseline, current, sizeof(baseline))) {
+                continue;
+            }
+            cpuidle_cpu_count = cpu + 1;
+            if (baseline[0] == '1') {
+                baseline_disable_mask[cpu] |= (1U << state);
+            }
+            if (current[0] == '1') {
+                applied_disable_mask[cpu] |= (1U << state);
+            }
+        }
+    }
+    for (int state = 0; state < cpuidle_state_count; state++) {
+        transition_time_us[state] = cpuidleSumCounter(state, "time");
+    }
+    pthread_mutex_unlock(&cpuidle_mutex);
+    PWRMGR_LOG_INFO("%d idle states on %d cpus", cpuidle_state_count, cpuidle_cpu_count);
+}
+
+/**
+ * @brief Restore the disable flags found at init.
+ * Must be called after the worker thread has been joined and the parked
+ * cores are back online.
+*/
+void powerCpuidleTerm(void)
+{
+    pthread_mutex_lock(&cpuidle_mutex);
+    for (int cpu = 0; cpu < cpuidle_cpu_count; cpu++) {
+        cpuidleWriteMask(cpu, baseline_disable_mask[cpu]);
+    }
+    pthread_mutex_unlock(&cpuidle_mutex);
+}
+
+/**
+ * @brief Worker action: apply the idle state disable mask and latency bound
+ * of the target state and restart the residency accounting.
+ * @param from The state being left.
+ * @param to The state being entered.
+ * @return true if all disable flags were written.
+*/
+bool powerCpuidleApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to)
+{
+    (void)from;
+    bool success = true;
+
+    pthread_mutex_lock(&cpuidle_mutex);
+    for (int cpu = 0; cpu < cpuidle_cpu_count; cpu++) {
+        /* States the platform disabled stay disabled. */
+        if (!cpuidleWriteMask(cpu, baseline_disable_mask[cpu] | powerStatePolicy[to].cpuidleDisableMask)) {
+            success = false;
+        }
+    }
+    for (int state = 0; state < cpuidle_state_count; state++) {
+        transition_time_us[state] = cpuidleSumCounter(state, "time");
+    }
+    pthread_mutex_unlock(&cpuidle_mutex);
+
+    powerQosSetStateLatency(powerStatePolicy[to].cpuDmaLatencyUs);
+    return success;
+}
+
+/**
+ * @brief Gets the cpuidle residency statistics.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_GetCpuidleStats(PWRMgr_CpuidleStats_t *stats)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (NULL == stats) {
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    if (pthread_mutex_lock(&cpuidle_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_GET_FAILURE;
+    }
+    memset(stats, 0, sizeof(*stats));
+    stats->stateCount = (uint32_t)cpuidle_state_count;
+    for (int state = 0; state < cpuidle_state_count; state++) {
+        PWRMgr_CpuidleStateStats_t *entry = &stats->states[state];
+        snprintf(entry->name, sizeof(entry->name), "%s", cpuidle_names[state]);
+        entry->usage = cpuidleSumCounter(state, "usage");
+        entry->timeUs = cpuidleSumCounter(state, "time");
+        entry->timeSinceTransitionUs = (entry->timeUs > transition_time_us[state]) ?
+                                       (entry->timeUs - transition_time_us[state]) : 0;
+        entry->disabled = (applied_disable_mask[0] & (1U << state)) != 0;
+    }
+    pthread_mutex_unlock(&cpuidle_mutex);
+    return PWRMGR_SUCCESS;
+}
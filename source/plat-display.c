@@ -0,0 +1,195 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Display blanking. States with displayBlank power the framebuffers down
+ * through /sys/class/graphics/fbN/blank; the other states unblank them. With
+ * vc4-kms fbN is the DRM fbdev emulation, whose blank only reaches the CRTC
+ * and the HDMI encoder (DPMS) if the emulation can take DRM master. While a
+ * compositor such as Westeros holds master, the kernel drops the request yet
+ * reports success, and setting the connector's DPMS property through KMS
+ * would need master just the same. Each write is therefore preceded by a
+ * probe of the card behind the framebuffer; if another client holds master
+ * the node is left alone, the action fails, and the blank is not recorded.
+ * The action heads the worker table: the screen goes dark before anything
+ * else slows down, and on resume it comes back last, once the CPU is at
+ * performance.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+
+#include "plat-power-priv.h"
+
+#define DISPLAY_MAX_FRAMEBUFFERS    4
+#define DISPLAY_DRM_CARD_MAX        16
+#define DISPLAY_DRM_DEVICE_FORMAT   "/dev/dri/%s"
+/* DRM_IOCTL_SET_MASTER from drm.h, which the HAL does not build against. */
+#define DISPLAY_DRM_IOCTL_SET_MASTER    _IO('d', 0x1e)
+
+typedef struct {
+    char path[PWRMGR_PATH_MAX];
+    char drmCard[DISPLAY_DRM_CARD_MAX]; ///< DRM card behind the fbdev emulation, empty for none
+    bool blanked;
+} DisplayNode_t;
+
+/* Only touched by the worker thread, or before it is started. */
+static DisplayNode_t display_nodes[DISPLAY_MAX_FRAMEBUFFERS];
+static int display_node_count = 0;
+static atomic_bool display_enabled = true;
+
+static void displayAddDrmCard(const char *path, void *context)
+{
+    DisplayNode_t *node = (DisplayNode_t *)context;
+    const char *name = strrchr(path, '/');
+    name = (NULL != name) ? name + 1 : path;
+    /* Skip the connectors, e.g. card0-HDMI-A-1. */
+    if (NULL == strchr(name, '-')) {
+        snprintf(node->drmCard, sizeof(node->drmCard), "%s", name);
+    }
+}
+
+static void displayAddNode(const char *path, void *context)
+{
+    (void)context;
+    if (display_node_count == DISPLAY_MAX_FRAMEBUFFERS) {
+        PWRMGR_LOG_WARN("Too many framebuffers, ignoring '%s'", path);
+        return;
+    }
+    DisplayNode_t *node = &display_nodes[display_node_count++];
+    memset(node, 0, sizeof(*node));
+    snprintf(node->path, sizeof(node->path), "%s", path);
+
+    char pattern[PWRMGR_PATH_MAX];
+    const char *slash = strrchr(path, '/');
+    int dirLength = (NULL != slash) ? (int)(slash - path) : 0;
+    snprintf(pattern, sizeof(pattern), "%.*s/device/drm/card*", dirLength, path);
+    sysfsGlob(pattern, displayAddDrmCard, node);
+}
+
+/**
+ * @brief Check whether another client holds DRM master on the node's card.
+ * Opening the card makes us master if nobody is; closing it drops that again.
+ * @return true if a blank written to the node would be dropped.
+*/
+static bool displayDrmMasterHeld(const DisplayNode_t *node)
+{
+    char device[PWRMGR_PATH_MAX];
+    char resolved[PWRMGR_PATH_MAX];
+    if ('\0' == node->drmCard[0]) {
+        return false;
+    }
+    snprintf(device, sizeof(device), DISPLAY_DRM_DEVICE_FORMAT, node->drmCard);
+    if (!sysfsResolvePath(device, resolved, sizeof(resolved))) {
+        return false;
+    }
+    int fd = open(resolved, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        PWRMGR_LOG_ERRNO("Failed to open '%s'", device);
+        return false;
+    }
+    bool held = ioctl(fd, DISPLAY_DRM_IOCTL_SET_MASTER) != 0 && EBUSY == errno;
+    close(fd);
+    return held;
+}
+
+/**
+ * @brief Blank or unblank every framebuffer not in the wanted state yet.
+ * @return true if every framebuffer accepted the request.
+*/
+static bool displaySetBlank(bool blank)
+{
+    bool success = true;
+    for (int i = 0; i < display_node_count; i++) {
+        DisplayNode_t *node = &display_nodes[i];
+        if (node->blanked == blank) {
+            continue;
+        }
+        if (displayDrmMasterHeld(node)) {
+            PWRMGR_LOG_ERROR("DRM master of %s is held by another client, '%s' left %s",
+                    node->drmCard, node->path, blank ? "on" : "blanked");
+            success = false;
+            continue;
+        }
+        if (!sysfsWriteLong(node->path, blank ? FB_BLANK_POWERDOWN : FB_BLANK_UNBLANK)) {
+            PWRMGR_LOG_ERRNO("'%s' <- %s failed", node->path, blank ? "powerdown" : "unblank");
+            success = false;
+            continue;
+        }
+        node->blanked = blank;
+    }
+    return success;
+}
+
+/**
+ * @brief Discover the framebuffers and the DRM cards behind them.
+ * Must be called before the worker thread is started.
+*/
+void powerDisplayInit(void)
+{
+    PWRMgr_PowerState_t restored;
+    display_node_count = 0;
+    atomic_store(&display_enabled, true);
+    sysfsGlob("/sys/class/graphics/fb*/blank", displayAddNode, NULL);
+    /* blank cannot be read back; after a restart assume the restored state is applied. */
+    bool blanked = powerShadowRestoredState(&restored) && powerStatePolicy[restored].displayBlank;
+    for (int i = 0; i < display_node_count; i++) {
+        display_nodes[i].blanked = blanked;
+    }
+    PWRMGR_LOG_INFO("%d framebuffers", display_node_count);
+}
+
+/**
+ * @brief Worker action: blank the display in the standby states, unblank it otherwise.
+ * @param from The state being left.
+ * @param to The state being entered.
+ * @return true if successful or there is nothing to do.
+*/
+bool powerDisplayApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to)
+{
+    (void)from;
+    return displaySetBlank(powerStatePolicy[to].displayBlank && atomic_load(&display_enabled));
+}
+
+/**
+ * @brief Unblank the framebuffers the HAL blanked.
+ * Must be called after the worker thread has been joined.
+*/
+void powerDisplayTerm(void)
+{
+    displaySetBlank(false);
+}
+
+/**
+ * @brief Enables or disables display blanking in the standby states.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_SetDisplayBlanking(bool enable)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    atomic_store(&display_enabled, enable);
+    return PWRMGR_SUCCESS;
+}
@@ -0,0 +1,152 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Staged standby escalation: STANDBY -> STANDBY_LIGHT_SLEEP ->
+ * STANDBY_DEEP_SLEEP after configurable idle periods. The worker arms the
+ * next stage whenever it has applied a state, and the stage deadline arms
+ * the worker's timerfd like the hint and alarm deadlines.
+ */
+#include <stdio.h>
+#include <pthread.h>
+
+#include "plat-power-priv.h"
+
+static pthread_mutex_t escalation_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t light_sleep_delay_ms = 0;
+static uint32_t deep_sleep_delay_ms = 0;
+/* State the idle period runs in, PWRMGR_POWERSTATE_MAX when disarmed. */
+static PWRMgr_PowerState_t escalation_state = PWRMGR_POWERSTATE_MAX;
+static uint64_t escalation_entered_ms = 0;
+
+/**
+ * @brief Get the next stage of a state. Call with escalation_mutex held.
+ * @return true if the state escalates, with the target and its idle period.
+*/
+static bool escalationNextStage(PWRMgr_PowerState_t state, PWRMgr_PowerState_t *target, uint32_t *delayMs)
+{
+    if (PWRMGR_POWERSTATE_STANDBY == state && light_sleep_delay_ms > 0) {
+        *target = PWRMGR_POWERSTATE_STANDBY_LIGHT_SLEEP;
+        *delayMs = light_sleep_delay_ms;
+        return true;
+    }
+    if ((PWRMGR_POWERSTATE_STANDBY == state || PWRMGR_POWERSTATE_STANDBY_LIGHT_SLEEP == state) &&
+        deep_sleep_delay_ms > 0) {
+        *target = PWRMGR_POWERSTATE_STANDBY_DEEP_SLEEP;
+        *delayMs = deep_sleep_delay_ms;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Disable the escalation and disarm any stage.
+ * Must be called before the worker thread is started.
+*/
+void powerEscalationInit(void)
+{
+    pthread_mutex_lock(&escalation_mutex);
+    light_sleep_delay_ms = 0;
+    deep_sleep_delay_ms = 0;
+    escalation_state = PWRMGR_POWERSTATE_MAX;
+    pthread_mutex_unlock(&escalation_mutex);
+}
+
+/**
+ * @brief Start the idle period of a freshly applied state. Worker thread only.
+*/
+void powerEscalationArm(PWRMgr_PowerState_t state)
+{
+    pthread_mutex_lock(&escalation_mutex);
+    escalation_state = state;
+    escalation_entered_ms = monotonicTimeMs();
+    pthread_mutex_unlock(&escalation_mutex);
+}
+
+/**
+ * @brief Drop the pending stage, e.g. on a state request or a wakeup.
+*/
+void powerEscalationCancel(void)
+{
+    pthread_mutex_lock(&escalation_mutex);
+    escalation_state = PWRMGR_POWERSTATE_MAX;
+    pthread_mutex_unlock(&escalation_mutex);
+}
+
+/**
+ * @brief Get the worker deadline of the pending stage.
+ * @return The deadline in monotonic ms, 0 if no stage is pending.
+*/
+uint64_t powerEscalationNextDeadline(void)
+{
+    PWRMgr_PowerState_t target;
+    uint32_t delayMs = 0;
+    uint64_t deadline = 0;
+    pthread_mutex_lock(&escalation_mutex);
+    if (escalationNextStage(escalation_state, &target, &delayMs)) {
+        deadline = escalation_entered_ms + delayMs;
+    }
+    pthread_mutex_unlock(&escalation_mutex);
+    return deadline;
+}
+
+/**
+ * @brief Check whether the idle period of the pending stage has passed.
+ * The stage is consumed; the worker arms the next one once it has been applied.
+ * @param target The state to escalate to.
+ * @return true if the worker should escalate.
+*/
+bool powerEscalationExpire(PWRMgr_PowerState_t *target)
+{
+    uint32_t delayMs = 0;
+    bool expired = false;
+    pthread_mutex_lock(&escalation_mutex);
+    if (escalationNextStage(escalation_state, target, &delayMs) &&
+        monotonicTimeMs() >= escalation_entered_ms + delayMs) {
+        escalation_state = PWRMGR_POWERSTATE_MAX;
+        expired = true;
+    }
+    pthread_mutex_unlock(&escalation_mutex);
+    return expired;
+}
+
+/**
+ * @brief Configures the automatic standby escalation.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_SetStandbyEscalation(uint32_t lightSleepDelaySec, uint32_t deepSleepDelaySec)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (pthread_mutex_lock(&escalation_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_SET_FAILURE;
+    }
+    /* Clamp to ~49 days so the millisecond delays cannot wrap. */
+    light_sleep_delay_ms = (lightSleepDelaySec > UINT32_MAX / 1000) ? UINT32_MAX : lightSleepDelaySec * 1000;
+    deep_sleep_delay_ms = (deepSleepDelaySec > UINT32_MAX / 1000) ? UINT32_MAX : deepSleepDelaySec * 1000;
+    pthread_mutex_unlock(&escalation_mutex);
+    PWRMGR_LOG_INFO("light sleep after %u s, deep sleep after %u s",
+                     lightSleepDelaySec, deepSleepDelaySec);
+
+    /* The idle period already running is measured against the new delays. */
+    powerMgrWakeWorker();
+    return PWRMGR_SUCCESS;
+}
@@ -0,0 +1,295 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * cgroup v2 freezer. Each power state names the entries of
+ * powerFreezerCgroups[] it keeps frozen. Freezing walks the table backwards
+ * and thawing forwards, so the UI is the last to stop and the first to run
+ * again. cgroup.freeze only requests the change; completion is confirmed
+ * through the "frozen" key of cgroup.events, which the kernel signals with
+ * POLLPRI, and the time until confirmation is reported as the latency.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "plat-power-priv.h"
+
+#define FREEZER_MAX_CGROUPS     32
+#define FREEZER_TIMEOUT_MS      500
+
+static pthread_mutex_t freezer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static PWRMgr_FreezerStats_t freezer_stats;
+
+/* Only touched by the worker thread, or before it is started. */
+static int freezer_count = 0;
+static uint32_t freezer_available = 0;
+static uint32_t freezer_baseline = 0;
+static uint32_t freezer_frozen = 0;
+static uint32_t freezer_state_mask = 0;
+static uint32_t freezer_prewake_thaw = 0;
+
+static bool freezerWrite(int index, bool frozen)
+{
+    char path[PWRMGR_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/cgroup.freeze", powerFreezerCgroups[index]);
+    return sysfsWriteString(path, frozen ? "1" : "0");
+}
+
+/**
+ * @brief Wait until cgroup.events reports the wanted freezer state.
+ * @param deadline Monotonic deadline in us.
+ * @return true if confirmed, or if the kernel offers no cgroup.events to wait on.
+*/
+static bool freezerWaitEvents(int index, bool frozen, uint64_t deadline)
+{
+    char path[PWRMGR_PATH_MAX];
+    char relative[PWRMGR_PATH_MAX];
+    snprintf(relative, sizeof(relative), "%s/cgroup.events", powerFreezerCgroups[index]);
+    if (!sysfsResolvePath(relative, path, sizeof(path))) {
+        return false;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return true;
+    }
+    const char *wanted = frozen ? "frozen 1" : "frozen 0";
+    bool confirmed = false;
+    while (!confirmed) {
+        char events[128] = {0};
+        ssize_t len = pread(fd, events, sizeof(events) - 1, 0);
+        if (len < 0) {
+            PWRMGR_LOG_ERRNO("Failed to read cgroup.events");
+            break;
+        }
+        events[len] = '\0';
+        confirmed = (NULL != strstr(events, wanted));
+        uint64_t now = monotonicTimeUs();
+        if (confirmed || now >= deadline) {
+            break;
+        }
+        struct pollfd pfd = { .fd = fd, .events = POLLPRI };
+        int timeoutMs = (int)((deadline - now + 999) / 1000);
+        if (poll(&pfd, 1, timeoutMs) < 0) {
+            PWRMGR_LOG_ERRNO("Failed to poll cgroup.events");
+            break;
+        }
+    }
+    close(fd);
+    return confirmed;
+}
+
+/**
+ * @brief Move the freezer to a mask of frozen entries.
+ * Freezes are requested from the back of the table, thaws from the front,
+ * then each change is confirmed in the same order.
+ * @return true if every write succeeded and every change was confirmed.
+*/
+static bool freezerApplyMask(uint32_t wanted)
+{
+    uint32_t toFreeze = wanted & freezer_available & ~freezer_frozen;
+    uint32_t toThaw = ~wanted & freezer_available & freezer_frozen;
+    bool success = true;
+    uint32_t timeouts = 0;
+
+    if (0 != toFreeze) {
+        uint64_t start = monotonicTimeUs();
+        uint64_t deadline = start + FREEZER_TIMEOUT_MS * 1000ULL;
+        uint32_t requested = 0;
+        for (int i = freezer_count - 1; i >= 0; i--) {
+            if (!(toFreeze & (1U << i))) {
+                continue;
+            }
+            if (freezerWrite(i, true)) {
+                requested |= (1U << i);
+                freezer_frozen |= (1U << i);
+            } else {
+                PWRMGR_LOG_ERRNO("Failed to freeze cgroup");
+                success = false;
+            }
+        }
+        for (int i = freezer_count - 1; i >= 0; i--) {
+            if ((requested & (1U << i)) && !freezerWaitEvents(i, true, deadline)) {
+                PWRMGR_LOG_ERROR("'%s' not frozen after %d ms", powerFreezerCgroups[i], FREEZER_TIMEOUT_MS);
+                timeouts++;
+            }
+        }
+        uint32_t elapsed = (uint32_t)(monotonicTimeUs() - start);
+        pthread_mutex_lock(&freezer_mutex);
+        freezer_stats.freezeCount++;
+        freezer_stats.lastFreezeUs = elapsed;
+        pthread_mutex_unlock(&freezer_mutex);
+        PWRMGR_LOG_INFO("Froze 0x%x in %u us", requested, elapsed);
+    }
+
+    if (0 != toThaw) {
+        uint64_t start = monotonicTimeUs();
+        uint64_t deadline = start + FREEZER_TIMEOUT_MS * 1000ULL;
+        uint32_t requested = 0;
+        uint32_t firstThawUs = 0;
+        for (int i = 0; i < freezer_count; i++) {
+            if (!(toThaw & (1U << i))) {
+                continue;
+            }
+            if (freezerWrite(i, false)) {
+                requested |= (1U << i);
+                freezer_frozen &= ~(1U << i);
+            } else {
+                PWRMGR_LOG_ERRNO("Failed to thaw cgroup");
+                success = false;
+            }
+        }
+        for (int i = 0; i < freezer_count; i++) {
+            if (!(requested & (1U << i))) {
+                continue;
+            }
+            if (!freezerWaitEvents(i, false, deadline)) {
+                PWRMGR_LOG_ERROR("'%s' not thawed after %d ms", powerFreezerCgroups[i], FREEZER_TIMEOUT_MS);
+                timeouts++;
+            }
+            if (0 == firstThawUs) {
+                firstThawUs = (uint32_t)(monotonicTimeUs() - start);
+            }
+        }
+        uint32_t elapsed = (uint32_t)(monotonicTimeUs() - start);
+        pthread_mutex_lock(&freezer_mutex);
+        freezer_stats.lastThawUs = elapsed;
+        freezer_stats.lastFirstThawUs = firstThawUs;
+        pthread_mutex_unlock(&freezer_mutex);
+        PWRMGR_LOG_INFO("Thawed 0x%x in %u us (first after %u us)", requested, elapsed, firstThawUs);
+    }
+
+    pthread_mutex_lock(&freezer_mutex);
+    freezer_stats.timeoutCount += timeouts;
+    freezer_stats.frozenCount = (uint32_t)__builtin_popcount(freezer_frozen);
+    pthread_mutex_unlock(&freezer_mutex);
+    return success && 0 == timeouts;
+}
+
+/**
+ * @brief Discover the freezable cgroups and snapshot their freezer state.
+ * Must be called before the worker thread is started.
+*/
+void powerFreezerInit(void)
+{
+    freezer_count = 0;
+    freezer_available = 0;
+    freezer_baseline = 0;
+    freezer_frozen = 0;
+    for (; NULL != powerFreezerCgroups[freezer_count] && freezer_count < FREEZER_MAX_CGROUPS; freezer_count++) {
+        char path[PWRMGR_PATH_MAX];
+        char value[8] = {0};
+        char current[8] = {0};
+        snprintf(path, sizeof(path), "%s/cgroup.freeze", powerFreezerCgroups[freezer_count]);
+        if (!powerShadowReadBaseline(path, value, current, sizeof(value))) {
+            PWRMGR_LOG_INFO("'%s' not available, skipping", path);
+            continue;
+        }
+        freezer_available |= (1U << freezer_count);
+        if (value[0] == '1') {
+            freezer_baseline |= (1U << freezer_count);
+        }
+        if (current[0] == '1') {
+            freezer_frozen |= (1U << freezer_count);
+        }
+    }
+    freezer_state_mask = freezer_baseline;
+    freezer_prewake_thaw = 0;
+    pthread_mutex_lock(&freezer_mutex);
+    memset(&freezer_stats, 0, sizeof(freezer_stats));
+    freezer_stats.frozenCount = (uint32_t)__builtin_popcount(freezer_frozen);
+    pthread_mutex_unlock(&freezer_mutex);
+    PWRMGR_LOG_INFO("freezable 0x%x frozen 0x%x", freezer_available, freezer_baseline);
+}
+
+/**
+ * @brief Worker action: freeze and thaw the cgroups of the target state.
+ * @param from The state being left.
+ * @param to The state being entered.
+ * @return true if every cgroup reached its freezer state in time.
+*/
+bool powerFreezerApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to)
+{
+    (void)from;
+    freezer_state_mask = powerStatePolicy[to].frozenCgroupMask;
+    return freezerApplyMask(freezer_state_mask & ~freezer_prewake_thaw);
+}
+
+/**
+ * @brief Pre-suspend hook: freeze every freezable cgroup. Worker thread only.
+ * @return true; a cgroup that is slow to freeze is left to the kernel freezer.
+*/
+bool powerFreezerSuspend(void)
+{
+    freezerApplyMask(freezer_available);
+    return true;
+}
+
+/**
+ * @brief Post-resume hook: go back to the cgroups of the current state.
+*/
+void powerFreezerResume(void)
+{
+    freezerApplyMask(freezer_state_mask & ~freezer_prewake_thaw);
+}
+
+/**
+ * @brief Keep some cgroups thawed ahead of a likely wake. Worker thread only.
+ * @param thawMask Entries of powerFreezerCgroups[] to thaw, 0 to end the pre-wake.
+*/
+void powerFreezerSetPrewake(uint32_t thawMask)
+{
+    if (thawMask != freezer_prewake_thaw) {
+        freezer_prewake_thaw = thawMask;
+        freezerApplyMask(freezer_state_mask & ~freezer_prewake_thaw);
+    }
+}
+
+/**
+ * @brief Restore the freezer state found at init.
+ * Must be called after the worker thread has been joined.
+*/
+void powerFreezerTerm(void)
+{
+    freezerApplyMask(freezer_baseline);
+}
+
+/**
+ * @brief Gets the cgroup freezer statistics.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_GetFreezerStats(PWRMgr_FreezerStats_t *stats)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (NULL == stats) {
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    if (pthread_mutex_lock(&freezer_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_GET_FAILURE;
+    }
+    *stats = freezer_stats;
+    pthread_mutex_unlock(&freezer_mutex);
+    return PWRMGR_SUCCESS;
+}
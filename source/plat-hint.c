@@ -0,0 +1,241 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "plat-power-priv.h"
+
+/* Number of concurrent references a single hint can hold. */
+#define POWER_HINT_MAX_REFS 16
+
+/* applied_uclamp_min when the knob holds a value not set by this instance. */
+#define HINT_UCLAMP_UNKNOWN -2
+
+#define CGROUP_UI_UCLAMP_MIN_PATH CGROUP_UI_SLICE_PATH "/cpu.uclamp.min"
+
+/* Reference expiry times in monotonic ms, 0 marks a free slot. Guarded by hint_mutex. */
+static pthread_mutex_t hint_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t hint_expiry[PWRMGR_HINT_MAX][POWER_HINT_MAX_REFS];
+
+/* Baseline snapshot and applied shadow, only touched by the worker thread. */
+static char baseline_uclamp_min[16] = {0};
+static const char *applied_governor = NULL;
+static int applied_floor_percent = -1;
+static int applied_uclamp_min = -1;
+
+/**
+ * @brief Snapshot the knobs the hints override so they can be restored.
+ * Must be called before the worker thread is started.
+*/
+void powerHintInit(void)
+{
+    pthread_mutex_lock(&hint_mutex);
+    memset(hint_expiry, 0, sizeof(hint_expiry));
+    pthread_mutex_unlock(&hint_mutex);
+
+    char current[sizeof(baseline_uclamp_min)];
+    applied_governor = NULL;
+    applied_floor_percent = -1;
+    applied_uclamp_min = -1;
+    if (!powerShadowReadBaseline(CGROUP_UI_UCLAMP_MIN_PATH, baseline_uclamp_min, current, sizeof(current))) {
+        baseline_uclamp_min[0] = '\0';
+    } else if (strcmp(current, baseline_uclamp_min) != 0) {
+        /* Boosted by a previous instance; rewritten on the first apply. */
+        applied_uclamp_min = HINT_UCLAMP_UNKNOWN;
+    }
+}
+
+/**
+ * @brief Drop all references and restore the baseline knobs.
+ * Must be called after the worker thread has been joined.
+*/
+void powerHintTerm(void)
+{
+    pthread_mutex_lock(&hint_mutex);
+    memset(hint_expiry, 0, sizeof(hint_expiry));
+    pthread_mutex_unlock(&hint_mutex);
+
+    if (applied_uclamp_min != -1 && baseline_uclamp_min[0] != '\0') {
+        if (!sysfsWriteString(CGROUP_UI_UCLAMP_MIN_PATH, baseline_uclamp_min)) {
+            PWRMGR_LOG_ERRNO("Failed to restore UI slice cpu.uclamp.min");
+        }
+    }
+    applied_governor = NULL;
+    applied_floor_percent = -1;
+    applied_uclamp_min = -1;
+}
+
+/**
+ * @brief Get the earliest expiry of all live hint references.
+ * @return The deadline in monotonic ms, 0 if no hint is active.
+*/
+uint64_t powerHintNextDeadline(void)
+{
+    uint64_t deadline = 0;
+    pthread_mutex_lock(&hint_mutex);
+    for (int hint = 0; hint < PWRMGR_HINT_MAX; hint++) {
+        for (int ref = 0; ref < POWER_HINT_MAX_REFS; ref++) {
+            uint64_t expiry = hint_expiry[hint][ref];
+            if (expiry != 0 && (deadline == 0 || expiry < deadline)) {
+                deadline = expiry;
+            }
+        }
+    }
+    pthread_mutex_unlock(&hint_mutex);
+    return deadline;
+}
+
+/**
+ * @brief Expire stale references and apply the aggregate of the active hints.
+ * Only knobs whose aggregate value changed are written; the frequency floor
+ * is only recorded for powerQosApply(). The UI slice cpu.uclamp.min is owned
+ * here and combines the hints with the power state policy. Called from the
+ * worker thread.
+ * @param state The power state currently applied by the worker.
+ * @param stateChanged true if the worker just rewrote the state governor.
+*/
+void powerHintApply(PWRMgr_PowerState_t state, bool stateChanged)
+{
+    const char *governor = NULL;
+    int minFreqPercent = -1;
+    int uclampMinPercent = -1;
+    uint64_t now = monotonicTimeMs();
+
+    pthread_mutex_lock(&hint_mutex);
+    for (int hint = 0; hint < PWRMGR_HINT_MAX; hint++) {
+        bool active = false;
+        for (int ref = 0; ref < POWER_HINT_MAX_REFS; ref++) {
+            if (hint_expiry[hint][ref] != 0 && hint_expiry[hint][ref] <= now) {
+                hint_expiry[hint][ref] = 0;
+            }
+            active = active || (hint_expiry[hint][ref] != 0);
+        }
+        if (!active || PWRMGR_POWERSTATE_OFF == state) {
+            continue;
+        }
+        const PowerHintPolicy_t *policy = &powerHintPolicy[hint];
+        if (NULL == governor) {
+            governor = policy->governor;
+        }
+        if (policy->minFreqPercent > minFreqPercent) {
+            minFreqPercent = policy->minFreqPercent;
+        }
+        if (policy->uclampMinPercent > uclampMinPercent) {
+            uclampMinPercent = policy->uclampMinPercent;
+        }
+    }
+    pthread_mutex_unlock(&hint_mutex);
+
+    if (stateChanged || governor != applied_governor) {
+        const char *target = (NULL != governor) ? governor : powerStatePolicy[state].governor;
+        /* The worker already wrote the state governor on a state change. */
+        if (NULL != target && !(stateChanged && NULL == governor)) {
+            PWRMGR_LOG_INFO("Setting governor '%s'", target);
+            if (!setCPUFreqScalingGovernor(target)) {
+                PWRMGR_LOG_ERRNO("Failed to set CPU frequency scaling governor");
+            }
+        }
+        applied_governor = governor;
+    }
+
+    /* The floor itself is written by the QoS aggregator together with the client requests. */
+    applied_floor_percent = minFreqPercent;
+
+    /* The UI slice boost of the power state is the floor of the hint boost. */
+    int stateUclampMin = powerStatePolicy[state].uiUclampMinPercent;
+    if (stateUclampMin > 0 && stateUclampMin > uclampMinPercent) {
+        uclampMinPercent = stateUclampMin;
+    }
+
+    if (uclampMinPercent != applied_uclamp_min && baseline_uclamp_min[0] != '\0') {
+        char value[16];
+        if (uclampMinPercent >= 0) {
+            snprintf(value, sizeof(value), "%d", uclampMinPercent);
+        } else {
+            snprintf(value, sizeof(value), "%s", baseline_uclamp_min);
+        }
+        if (sysfsWriteString(CGROUP_UI_UCLAMP_MIN_PATH, value)) {
+            applied_uclamp_min = uclampMinPercent;
+        } else {
+            PWRMGR_LOG_ERRNO("Failed to set UI slice cpu.uclamp.min");
+        }
+    }
+}
+
+/**
+ * @brief Get the CPU frequency floor requested by the active hints.
+ * Called from the worker thread after powerHintApply().
+ * @return The floor as a percentage of the cpuinfo range, -1 if none.
+*/
+int powerHintFloorPercent(void)
+{
+    return applied_floor_percent;
+}
+
+/**
+ * @brief Requests a temporary, workload specific performance boost.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_PowerHint(PWRMgr_PowerHint_t hint, uint32_t durationMs)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (!(hint >= PWRMGR_HINT_APP_LAUNCH && hint < PWRMGR_HINT_MAX)) {
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    if (durationMs > powerHintPolicy[hint].maxDurationMs) {
+        durationMs = powerHintPolicy[hint].maxDurationMs;
+    }
+
+    uint64_t now = monotonicTimeMs();
+    if (pthread_mutex_lock(&hint_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_SET_FAILURE;
+    }
+    /* Pick a free slot to take a reference, or the reference closest to expiry. */
+    int slot = -1;
+    for (int ref = 0; ref < POWER_HINT_MAX_REFS; ref++) {
+        uint64_t expiry = hint_expiry[hint][ref];
+        if (durationMs != 0 && expiry == 0) {
+            slot = ref;
+            break;
+        }
+        if (expiry != 0 && (slot < 0 || expiry < hint_expiry[hint][slot])) {
+            slot = ref;
+        }
+    }
+    if (slot >= 0) {
+        if (durationMs == 0) {
+            hint_expiry[hint][slot] = 0;
+        } else if (hint_expiry[hint][slot] < now + durationMs) {
+            /* Either a free slot or, when all are taken, extend the oldest one. */
+            hint_expiry[hint][slot] = now + durationMs;
+        }
+    }
+    if (pthread_mutex_unlock(&hint_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to unlock mutex");
+        return PWRMGR_SET_FAILURE;
+    }
+
+    PWRMGR_LOG_INFO("'%s' for %u ms", powerHintPolicy[hint].name, durationMs);
+    powerMgrWakeWorker();
+    return PWRMGR_SUCCESS;
+}
@@ -0,0 +1,223 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Transition journal. Every HAL start, power state transition and reset is
+ * appended as a fixed size binary record to a ring in an mmap'd file, so the
+ * history leading up to a reboot can be read back after it. Appending is a
+ * store into the page cache; the kernel writes it back on its own and only
+ * resets and power off force it out with msync(). Each record carries a
+ * sequence number and a checksum written last: a record torn by a crash
+ * fails its checksum and is skipped by the reader, the others stay valid.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "plat-power-priv.h"
+
+#define JOURNAL_PATH            "/opt/persistent/pwrmgr_journal.bin"
+#define JOURNAL_MAGIC           0x504A5752  /* "PJWR" */
+#define JOURNAL_VERSION         1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t capacity;
+    uint32_t reserved;
+} JournalHeader_t;
+
+typedef struct {
+    JournalHeader_t header;
+    PWRMgr_JournalRecord_t records[PWRMGR_JOURNAL_MAX_RECORDS];
+} JournalFile_t;
+
+static pthread_mutex_t journal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static JournalFile_t *journal_map = NULL;
+static uint32_t journal_next_sequence = 1;
+
+/**
+ * @brief FNV-1a over every field of a record but the checksum.
+*/
+static uint32_t journalChecksum(const PWRMgr_JournalRecord_t *record)
+{
+    const uint8_t *bytes = (const uint8_t *)record;
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < offsetof(PWRMgr_JournalRecord_t, checksum); i++) {
+        hash = (hash ^ bytes[i]) * 16777619U;
+    }
+    /* 0 marks a slot being written. */
+    return (0 == hash) ? 1 : hash;
+}
+
+static bool journalRecordValid(const PWRMgr_JournalRecord_t *record)
+{
+    return 0 != record->sequence && record->checksum == journalChecksum(record);
+}
+
+/**
+ * @brief Map the journal file, creating or resetting it if needed.
+ * Must be called before the worker thread is started.
+*/
+void powerJournalInit(void)
+{
+    char path[PWRMGR_PATH_MAX];
+    pthread_mutex_lock(&journal_mutex);
+    if (NULL != journal_map || !sysfsResolvePath(JOURNAL_PATH, path, sizeof(path))) {
+        pthread_mutex_unlock(&journal_mutex);
+        return;
+    }
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        PWRMGR_LOG_ERRNO("Failed to open journal");
+        pthread_mutex_unlock(&journal_mutex);
+        return;
+    }
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, sizeof(JournalFile_t)) == 0) {
+        map = mmap(NULL, sizeof(JournalFile_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    /* The mapping keeps the file referenced. */
+    close(fd);
+    if (MAP_FAILED == map) {
+        PWRMGR_LOG_ERRNO("Failed to map journal");
+        pthread_mutex_unlock(&journal_mutex);
+        return;
+    }
+    journal_map = map;
+    JournalHeader_t *header = &journal_map->header;
+    if (JOURNAL_MAGIC != header->magic || JOURNAL_VERSION != header->version ||
+        sizeof(PWRMgr_JournalRecord_t) != header->recordSize || PWRMGR_JOURNAL_MAX_RECORDS != header->capacity) {
+        memset(journal_map, 0, sizeof(*journal_map));
+        header->magic = JOURNAL_MAGIC;
+        header->version = JOURNAL_VERSION;
+        header->recordSize = sizeof(PWRMgr_JournalRecord_t);
+        header->capacity = PWRMGR_JOURNAL_MAX_RECORDS;
+    }
+    journal_next_sequence = 1;
+    for (int i = 0; i < PWRMGR_JOURNAL_MAX_RECORDS; i++) {
+        const PWRMgr_JournalRecord_t *record = &journal_map->records[i];
+        if (journalRecordValid(record) && record->sequence >= journal_next_sequence) {
+            journal_next_sequence = record->sequence + 1;
+        }
+    }
+    pthread_mutex_unlock(&journal_mutex);
+    PWRMGR_LOG_INFO("Journal at sequence %u", journal_next_sequence);
+}
+
+/**
+ * @brief Append a record to the journal.
+ * @param kind What happened.
+ * @param from The state before, PWRMGR_POWERSTATE_MAX if not applicable.
+ * @param to The state after.
+ * @param success Whether it succeeded.
+ * @param latencyUs How long it took.
+ * @param flush Force the record out to storage before returning.
+*/
+void powerJournalAppend(PWRMgr_JournalKind_t kind, PWRMgr_PowerState_t from, PWRMgr_PowerState_t to,
+                        bool success, uint32_t latencyUs, bool flush)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    pthread_mutex_lock(&journal_mutex);
+    if (NULL == journal_map) {
+        pthread_mutex_unlock(&journal_mutex);
+        return;
+    }
+    uint32_t sequence = journal_next_sequence++;
+    PWRMgr_JournalRecord_t *record = &journal_map->records[sequence % PWRMGR_JOURNAL_MAX_RECORDS];
+    record->checksum = 0;
+    atomic_thread_fence(memory_order_release);
+    record->sequence = sequence;
+    record->kind = (uint8_t)kind;
+    record->from = (uint8_t)from;
+    record->to = (uint8_t)to;
+    record->success = success ? 1 : 0;
+    record->wallTimeMs = (uint64_t)now.tv_sec * 1000ULL + (uint64_t)now.tv_nsec / 1000000ULL;
+    record->latencyUs = latencyUs;
+    record->uptimeSec = (uint32_t)(monotonicTimeMs() / 1000);
+    record->reserved = 0;
+    atomic_thread_fence(memory_order_release);
+    record->checksum = journalChecksum(record);
+    if (flush && msync(journal_map, sizeof(*journal_map), MS_SYNC) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to flush journal");
+    }
+    pthread_mutex_unlock(&journal_mutex);
+}
+
+/**
+ * @brief Flush and unmap the journal.
+ * Must be called after the worker thread has been joined.
+*/
+void powerJournalTerm(void)
+{
+    pthread_mutex_lock(&journal_mutex);
+    if (NULL != journal_map) {
+        msync(journal_map, sizeof(*journal_map), MS_SYNC);
+        munmap(journal_map, sizeof(*journal_map));
+        journal_map = NULL;
+    }
+    pthread_mutex_unlock(&journal_mutex);
+}
+
+/**
+ * @brief Reads the transition journal.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_GetJournal(PWRMgr_JournalRecord_t *records, uint32_t *count)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (NULL == records || NULL == count) {
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    if (pthread_mutex_lock(&journal_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_GET_FAILURE;
+    }
+    if (NULL == journal_map) {
+        pthread_mutex_unlock(&journal_mutex);
+        return PWRMGR_OPERATION_NOT_SUPPORTED;
+    }
+    /* Walk back from the newest record, then hand them out oldest first. */
+    uint32_t found = 0;
+    uint32_t sequence = journal_next_sequence;
+    for (uint32_t i = 0; i < PWRMGR_JOURNAL_MAX_RECORDS && found < *count && sequence > 1; i++) {
+        sequence--;
+        const PWRMgr_JournalRecord_t *record = &journal_map->records[sequence % PWRMGR_JOURNAL_MAX_RECORDS];
+        if (journalRecordValid(record) && record->sequence == sequence) {
+            records[found++] = *record;
+        }
+    }
+    pthread_mutex_unlock(&journal_mutex);
+    for (uint32_t i = 0; i < found / 2; i++) {
+        PWRMgr_JournalRecord_t swap = records[i];
+        records[i] = records[found - 1 - i];
+        records[found - 1 - i] = swap;
+    }
+    *count = found;
+    return PWRMGR_SUCCESS;
+}
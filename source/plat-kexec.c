@@ -0,0 +1,253 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * kexec fast reboot, built with --enable-kexecreboot. The kernel and initrd
+ * on the boot partition are loaded with kexec_file_load() at PLAT_INIT(), so
+ * PLAT_Reset() can jump straight into them and skip the VideoCore firmware
+ * boot. If the images changed on disk since (an upgrade), or the preload
+ * failed, they are loaded again at reset. PLAT_Reset() falls back to a full
+ * RB_AUTOBOOT whenever the kexec cannot be started. The two system calls go
+ * through PowerKexecOps_t so the path can be exercised without rebooting.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/reboot.h>
+#include <linux/kexec.h>
+#include <linux/reboot.h>
+
+#include "plat-power-priv.h"
+
+#define PROC_CMDLINE_PATH   "/proc/cmdline"
+#define KEXEC_CMDLINE_MAX   1024
+
+typedef struct {
+    const char *kernel;
+    const char *initrd;             ///< Loaded when present
+} KexecImage_t;
+
+/* Boot partition layouts, newest first. */
+static const KexecImage_t kexecImages[] = {
+    { "/boot/firmware/kernel8.img", "/boot/firmware/initramfs8" },
+    { "/boot/kernel8.img",          "/boot/initramfs8" },
+};
+
+typedef struct {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    time_t mtime;
+} KexecStamp_t;
+
+#ifdef ENABLE_KEXEC_REBOOT
+
+static long kexecFileLoadSyscall(int kernelFd, int initrdFd, unsigned long cmdlineLen,
+                                 const char *cmdline, unsigned long flags)
+{
+#ifdef SYS_kexec_file_load
+    return syscall(SYS_kexec_file_load, kernelFd, initrdFd, cmdlineLen, cmdline, flags);
+#else
+    (void)kernelFd; (void)initrdFd; (void)cmdlineLen; (void)cmdline; (void)flags;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static int kexecRebootSyscall(int cmd)
+{
+    return reboot(cmd);
+}
+
+static const PowerKexecOps_t kexecSyscalls = {
+    kexecFileLoadSyscall,
+    kexecRebootSyscall,
+};
+
+#endif /* ENABLE_KEXEC_REBOOT */
+
+/* Only touched by PLAT_INIT(), PLAT_Reset() and PLAT_TERM(). */
+static const PowerKexecOps_t *kexec_ops = NULL;
+static bool kexec_enabled = false;
+static bool kexec_loaded = false;
+static KexecStamp_t kexec_kernel_stamp;
+static KexecStamp_t kexec_initrd_stamp;
+
+/**
+ * @brief Open an image and record what it is.
+ * @return The fd, or -1 if the image is missing.
+*/
+static int kexecOpenImage(const char *path, KexecStamp_t *stamp)
+{
+    char resolved[PWRMGR_PATH_MAX];
+    struct stat st;
+    memset(stamp, 0, sizeof(*stamp));
+    if (!sysfsResolvePath(path, resolved, sizeof(resolved))) {
+        return -1;
+    }
+    int fd = open(resolved, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    stamp->device = st.st_dev;
+    stamp->inode = st.st_ino;
+    stamp->size = st.st_size;
+    stamp->mtime = st.st_mtime;
+    return fd;
+}
+
+static bool kexecStampChanged(const char *path, const KexecStamp_t *loaded)
+{
+    KexecStamp_t current;
+    int fd = kexecOpenImage(path, &current);
+    if (fd >= 0) {
+        close(fd);
+    }
+    return memcmp(&current, loaded, sizeof(current)) != 0;
+}
+
+static const KexecImage_t *kexecFindImage(void)
+{
+    for (size_t i = 0; i < sizeof(kexecImages) / sizeof(kexecImages[0]); i++) {
+        char resolved[PWRMGR_PATH_MAX];
+        if (sysfsResolvePath(kexecImages[i].kernel, resolved, sizeof(resolved)) &&
+            access(resolved, R_OK) == 0) {
+            return &kexecImages[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Load the kernel, initrd and running command line as the kexec image.
+ * @return true if the kernel accepted the image.
+*/
+static bool kexecLoad(void)
+{
+    char cmdline[KEXEC_CMDLINE_MAX] = {0};
+    const KexecImage_t *image = kexecFindImage();
+    if (NULL == image) {
+        PWRMGR_LOG_ERROR("No kernel image found");
+        return false;
+    }
+    if (!sysfsReadString(PROC_CMDLINE_PATH, cmdline, sizeof(cmdline))) {
+        PWRMGR_LOG_ERRNO("Failed to read the kernel command line");
+        return false;
+    }
+    int kernelFd = kexecOpenImage(image->kernel, &kexec_kernel_stamp);
+    int initrdFd = kexecOpenImage(image->initrd, &kexec_initrd_stamp);
+    unsigned long flags = (initrdFd < 0) ? KEXEC_FILE_NO_INITRAMFS : 0;
+    uint64_t start = monotonicTimeUs();
+    bool loaded = kernelFd >= 0 &&
+                  kexec_ops->kexecFileLoad(kernelFd, initrdFd, strlen(cmdline) + 1, cmdline, flags) == 0;
+    if (!loaded) {
+        PWRMGR_LOG_ERRNO("kexec_file_load failed");
+    } else {
+        PWRMGR_LOG_INFO("Loaded '%s'%s in %llu us", image->kernel, (initrdFd < 0) ? "" : " with initrd",
+                         (unsigned long long)(monotonicTimeUs() - start));
+    }
+    if (kernelFd >= 0) {
+        close(kernelFd);
+    }
+    if (initrdFd >= 0) {
+        close(initrdFd);
+    }
+    kexec_loaded = loaded;
+    return loaded;
+}
+
+/**
+ * @brief Preload the kexec image. Failures are retried at reset.
+*/
+void powerKexecInit(void)
+{
+#ifdef ENABLE_KEXEC_REBOOT
+    if (NULL == kexec_ops) {
+        kexec_ops = &kexecSyscalls;
+    }
+    kexec_enabled = true;
+    kexecLoad();
+#endif
+    PWRMGR_LOG_INFO("kexec reboot %s",
+                     !kexec_enabled ? "disabled" : (kexec_loaded ? "armed" : "deferred to reset"));
+}
+
+/**
+ * @brief Unload the kexec image, releasing the memory the kernel holds for it.
+*/
+void powerKexecTerm(void)
+{
+    if (!kexec_loaded) {
+        return;
+    }
+    if (kexec_ops->kexecFileLoad(-1, -1, 0, NULL, KEXEC_FILE_UNLOAD) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to unload the kexec image");
+    }
+    kexec_loaded = false;
+}
+
+/**
+ * @brief Reboot into the preloaded kernel.
+ * Loads it first if the preload failed or the images changed on disk.
+ * @return false if the kexec could not be started; the caller then reboots normally.
+*/
+bool powerKexecReboot(void)
+{
+    if (!kexec_enabled) {
+        return false;
+    }
+    const KexecImage_t *image = kexecFindImage();
+    if (kexec_loaded && (NULL == image || kexecStampChanged(image->kernel, &kexec_kernel_stamp) ||
+                         kexecStampChanged(image->initrd, &kexec_initrd_stamp))) {
+        PWRMGR_LOG_INFO("Boot images changed since PLAT_INIT, reloading");
+        kexec_loaded = false;
+    }
+    if (!kexec_loaded && !kexecLoad()) {
+        return false;
+    }
+    PWRMGR_LOG_INFO("Rebooting through kexec");
+    powerLogFlush();
+    /* Only returns on failure. */
+    kexec_ops->reboot(LINUX_REBOOT_CMD_KEXEC);
+    PWRMGR_LOG_ERRNO("Failed to kexec");
+    return false;
+}
+
+/**
+ * @brief Replace the system calls used for kexec, e.g. to test PLAT_Reset().
+ * Must be called before PLAT_INIT().
+ * @param ops The replacement, NULL to restore the default.
+*/
+void powerKexecSetOps(const PowerKexecOps_t *ops)
+{
+    kexec_ops = ops;
+#ifdef ENABLE_KEXEC_REBOOT
+    if (NULL == kexec_ops) {
+        kexec_ops = &kexecSyscalls;
+    }
+#endif
+}
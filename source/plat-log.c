@@ -0,0 +1,363 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * HAL log. The PWRMGR_LOG_* macros format a message on the calling thread
+ * straight into a slot of a bounded lock-free ring (sequence numbered slots,
+ * producers claim one with a CAS) and return; a flusher thread writes the
+ * records to syslog, or as key=value lines to the file named by
+ * PWRMGR_LOG_FILE. A full ring drops the message and counts it rather than
+ * wait, so a stalled syslog never holds up a PLAT_API_* caller. Each call
+ * site is rate limited to PWRMGR_LOG_BURST messages per interval; what it
+ * suppressed is reported with its next message. Outside PLAT_INIT() and
+ * PLAT_TERM() messages are written synchronously to stderr.
+ */
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "plat-power-priv.h"
+
+#define LOG_RING_SIZE           256         /* Power of two */
+#define LOG_MESSAGE_MAX         224
+#define LOG_SYSLOG_IDENT        "pwrmgr-hal"
+
+typedef struct {
+    const PowerLogSite_t *site;
+    uint64_t wallTimeMs;
+    pid_t tid;
+    int errnum;
+    uint32_t suppressed;
+    PWRMgr_LogLevel_t level;
+    char message[LOG_MESSAGE_MAX];
+} LogRecord_t;
+
+typedef struct {
+    atomic_size_t sequence;         ///< Ring position it is free for, that position + 1 once filled
+    LogRecord_t record;
+} LogSlot_t;
+
+static const char *const logLevelNames[PWRMGR_LOGLEVEL_MAX] = {
+    "error", "warn", "info", "debug"
+};
+
+static const int logSyslogPriority[PWRMGR_LOGLEVEL_MAX] = {
+    LOG_ERR, LOG_WARNING, LOG_INFO, LOG_DEBUG
+};
+
+atomic_int powerLogLevel = PWRMGR_LOGLEVEL_INFO;
+
+static LogSlot_t log_ring[LOG_RING_SIZE];
+static atomic_size_t log_head = 0;
+static atomic_uint log_dropped = 0;
+static atomic_bool log_running = false;
+
+/* The consumer side, shared by the flusher and powerLogFlush(). */
+static pthread_mutex_t log_consumer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static size_t log_tail = 0;
+static FILE *log_file = NULL;
+
+static pthread_t log_thread;
+static sem_t log_semaphore;
+
+/**
+ * @brief Format a record as one line: "func: message[: strerror][ (N suppressed)]".
+*/
+static void logFormatLine(const LogRecord_t *record, char *line, size_t size)
+{
+    size_t length = (size_t)snprintf(line, size, "%s: %s", record->site->func, record->message);
+    if (0 != record->errnum && length < size) {
+        length += (size_t)snprintf(line + length, size - length, ": %s", strerror(record->errnum));
+    }
+    if (0 != record->suppressed && length < size) {
+        snprintf(line + length, size - length, " (%u similar suppressed)", record->suppressed);
+    }
+}
+
+/**
+ * @brief Write one record to the sink. Called with log_consumer_mutex held,
+ * or synchronously while the flusher is not running.
+*/
+static void logEmit(const LogRecord_t *record)
+{
+    char line[LOG_MESSAGE_MAX + 128];
+    if (!atomic_load(&log_running)) {
+        logFormatLine(record, line, sizeof(line));
+        fprintf(stderr, "%s\n", line);
+        return;
+    }
+    if (NULL == log_file) {
+        logFormatLine(record, line, sizeof(line));
+        syslog(logSyslogPriority[record->level], "%s", line);
+        return;
+    }
+    struct tm tm;
+    time_t seconds = (time_t)(record->wallTimeMs / 1000);
+    gmtime_r(&seconds, &tm);
+    fprintf(log_file, "time=%04d-%02d-%02dT%02d:%02d:%02d.%03uZ level=%s tid=%d func=%s line=%d msg=\"",
+            tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+            (unsigned)(record->wallTimeMs % 1000), logLevelNames[record->level], (int)record->tid,
+            record->site->func, record->site->line);
+    for (const char *c = record->message; *c != '\0'; c++) {
+        if ('"' == *c || '\\' == *c) {
+            fputc('\\', log_file);
+        }
+        fputc(*c, log_file);
+    }
+    fputc('"', log_file);
+    if (0 != record->errnum) {
+        fprintf(log_file, " errno=%d error=\"%s\"", record->errnum, strerror(record->errnum));
+    }
+    if (0 != record->suppressed) {
+        fprintf(log_file, " suppressed=%u", record->suppressed);
+    }
+    fputc('\n', log_file);
+}
+
+/**
+ * @brief Write out every filled slot. Called with log_consumer_mutex held.
+*/
+static void logDrain(void)
+{
+    while (1) {
+        LogSlot_t *slot = &log_ring[log_tail & (LOG_RING_SIZE - 1)];
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != log_tail + 1) {
+            break;
+        }
+        logEmit(&slot->record);
+        atomic_store_explicit(&slot->sequence, log_tail + LOG_RING_SIZE, memory_order_release);
+        log_tail++;
+    }
+    unsigned dropped = atomic_exchange(&log_dropped, 0);
+    if (0 != dropped) {
+        static const PowerLogSite_t site = { "powerLog", __LINE__, 0, 0, 0 };
+        LogRecord_t record = { &site, 0, 0, 0, 0, PWRMGR_LOGLEVEL_WARN, "" };
+        record.wallTimeMs = (uint64_t)time(NULL) * 1000ULL;
+        snprintf(record.message, sizeof(record.message), "Ring full, %u messages dropped", dropped);
+        logEmit(&record);
+    }
+    if (NULL != log_file) {
+        fflush(log_file);
+    }
+}
+
+static void *logFlusherThread(void *arg)
+{
+    (void)arg;
+    while (atomic_load(&log_running)) {
+        if (sem_wait(&log_semaphore) != 0 && EINTR != errno) {
+            break;
+        }
+        pthread_mutex_lock(&log_consumer_mutex);
+        logDrain();
+        pthread_mutex_unlock(&log_consumer_mutex);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Check the call site's rate limit.
+ * @param suppressed Set to the messages suppressed since the last one let through.
+ * @return false if the message is to be suppressed.
+*/
+static bool logRateLimit(PowerLogSite_t *site, uint32_t *suppressed)
+{
+    uint64_t now = monotonicTimeMs();
+    uint64_t start = atomic_load_explicit(&site->windowStartMs, memory_order_relaxed);
+    *suppressed = 0;
+    if ((0 == start || now - start >= PWRMGR_LOG_INTERVAL_MS) &&
+        atomic_compare_exchange_strong(&site->windowStartMs, &start, now)) {
+        atomic_store(&site->count, 0);
+        *suppressed = atomic_exchange(&site->suppressed, 0);
+    }
+    if (atomic_fetch_add(&site->count, 1) >= PWRMGR_LOG_BURST) {
+        atomic_fetch_add(&site->suppressed, 1);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Log a message; use the PWRMGR_LOG_* macros rather than calling this.
+ * Never blocks: the message is dropped if the ring is full.
+ * @param site The call site.
+ * @param level The severity.
+ * @param errnum errno to report with the message, 0 for none.
+ * @param format printf() format of the message, without a trailing newline.
+*/
+void powerLogWrite(PowerLogSite_t *site, PWRMgr_LogLevel_t level, int errnum, const char *format, ...)
+{
+    LogRecord_t local;
+    LogRecord_t *record = &local;
+    LogSlot_t *slot = NULL;
+    size_t position = 0;
+    uint32_t suppressed;
+    va_list args;
+
+    if (!logRateLimit(site, &suppressed)) {
+        return;
+    }
+    if (atomic_load(&log_running)) {
+        position = atomic_load_explicit(&log_head, memory_order_relaxed);
+        while (1) {
+            slot = &log_ring[position & (LOG_RING_SIZE - 1)];
+            size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+            if (0 == difference) {
+                if (atomic_compare_exchange_weak_explicit(&log_head, &position, position + 1,
+                                                          memory_order_relaxed, memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                /* Full: the flusher is behind. */
+                atomic_fetch_add(&log_dropped, 1);
+                return;
+            } else {
+                position = atomic_load_explicit(&log_head, memory_order_relaxed);
+            }
+        }
+        record = &slot->record;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    record->site = site;
+    record->wallTimeMs = (uint64_t)now.tv_sec * 1000ULL + (uint64_t)now.tv_nsec / 1000000ULL;
+    record->tid = (pid_t)syscall(SYS_gettid);
+    record->errnum = errnum;
+    record->suppressed = suppressed;
+    record->level = level;
+    va_start(args, format);
+    vsnprintf(record->message, sizeof(record->message), format, args);
+    va_end(args);
+
+    if (NULL == slot) {
+        logEmit(record);
+        return;
+    }
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+    sem_post(&log_semaphore);
+}
+
+/**
+ * @brief Open the sink and start the flusher.
+ * Must be called first thing in PLAT_INIT().
+*/
+void powerLogInit(void)
+{
+    const char *level = getenv(PWRMGR_LOG_LEVEL_ENV);
+    const char *file = getenv(PWRMGR_LOG_FILE_ENV);
+    if (atomic_load(&log_running)) {
+        return;
+    }
+    for (int i = 0; NULL != level && i < PWRMGR_LOGLEVEL_MAX; i++) {
+        if (strcmp(level, logLevelNames[i]) == 0) {
+            atomic_store(&powerLogLevel, i);
+        }
+    }
+    for (size_t i = 0; i < LOG_RING_SIZE; i++) {
+        atomic_store(&log_ring[i].sequence, i);
+    }
+    atomic_store(&log_head, 0);
+    log_tail = 0;
+    log_file = NULL;
+    if (NULL != file && file[0] != '\0') {
+        log_file = fopen(file, "ae");
+        if (NULL == log_file) {
+            perror("powerLogInit: Failed to open log file, using syslog");
+        }
+    }
+    if (NULL == log_file) {
+        openlog(LOG_SYSLOG_IDENT, LOG_PID, LOG_DAEMON);
+    }
+    if (sem_init(&log_semaphore, 0, 0) != 0) {
+        perror("powerLogInit: Failed to initialize semaphore");
+        return;
+    }
+    atomic_store(&log_running, true);
+    if (pthread_create(&log_thread, NULL, logFlusherThread, NULL) != 0) {
+        perror("powerLogInit: Failed to create flusher thread");
+        atomic_store(&log_running, false);
+        sem_destroy(&log_semaphore);
+    }
+}
+
+/**
+ * @brief Write out everything logged so far from the calling thread.
+ * Used before rebooting, when the flusher would not get to run.
+*/
+void powerLogFlush(void)
+{
+    pthread_mutex_lock(&log_consumer_mutex);
+    if (atomic_load(&log_running)) {
+        logDrain();
+    }
+    pthread_mutex_unlock(&log_consumer_mutex);
+}
+
+/**
+ * @brief Flush the ring, stop the flusher and close the sink.
+ * Must be called last thing in PLAT_TERM().
+*/
+void powerLogTerm(void)
+{
+    if (!atomic_load(&log_running)) {
+        return;
+    }
+    pthread_mutex_lock(&log_consumer_mutex);
+    logDrain();
+    atomic_store(&log_running, false);
+    pthread_mutex_unlock(&log_consumer_mutex);
+    sem_post(&log_semaphore);
+    pthread_join(log_thread, NULL);
+    sem_destroy(&log_semaphore);
+    /* Messages raced in after the final drain go to stderr. */
+    pthread_mutex_lock(&log_consumer_mutex);
+    logDrain();
+    pthread_mutex_unlock(&log_consumer_mutex);
+    if (NULL != log_file) {
+        fclose(log_file);
+        log_file = NULL;
+    } else {
+        closelog();
+    }
+}
+
+/**
+ * @brief Sets the verbosity of the HAL log.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_SetLogLevel(PWRMgr_LogLevel_t level)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if ((int)level < PWRMGR_LOGLEVEL_ERROR || level >= PWRMGR_LOGLEVEL_MAX) {
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    atomic_store(&powerLogLevel, level);
+    return PWRMGR_SUCCESS;
+}
@@ -0,0 +1,176 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Memory housekeeping on entry to a standby state: proactive cgroup reclaim,
+ * compaction and dropping caches, as listed by the power state policy. Reclaim
+ * is issued in chunks so it can stop at its time budget; a chunk the kernel
+ * cannot satisfy (EAGAIN) ends the action early.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "plat-power-priv.h"
+
+#define VM_COMPACT_MEMORY_PATH  "/proc/sys/vm/compact_memory"
+#define VM_DROP_CACHES_PATH     "/proc/sys/vm/drop_caches"
+#define PROC_MEMINFO_PATH       "/proc/meminfo"
+#define MEMORY_RECLAIM_CHUNK    (16L << 20)
+
+static pthread_mutex_t memory_mutex = PTHREAD_MUTEX_INITIALIZER;
+static PWRMgr_MemoryStats_t memory_stats;
+
+/**
+ * @brief Read MemAvailable from /proc/meminfo.
+ * @return The value in kB, 0 if unknown.
+*/
+static uint64_t memoryAvailableKb(void)
+{
+    /* MemAvailable is the third line, well within the first 256 bytes. */
+    char meminfo[256] = {0};
+    if (!sysfsReadString(PROC_MEMINFO_PATH, meminfo, sizeof(meminfo))) {
+        return 0;
+    }
+    const char *line = strstr(meminfo, "MemAvailable:");
+    return (NULL != line) ? strtoull(line + strlen("MemAvailable:"), NULL, 10) : 0;
+}
+
+/**
+ * @brief Reclaim up to action->amount bytes from a cgroup within the budget.
+ * @return The number of bytes reclaimed.
+*/
+static uint64_t memoryReclaim(const MemoryAction_t *action, uint64_t deadline)
+{
+    char path[PWRMGR_PATH_MAX];
+    uint64_t reclaimed = 0;
+    snprintf(path, sizeof(path), "%s/memory.reclaim", action->cgroup);
+    while ((long)reclaimed < action->amount && monotonicTimeUs() < deadline) {
+        long chunk = action->amount - (long)reclaimed;
+        chunk = (chunk > MEMORY_RECLAIM_CHUNK) ? MEMORY_RECLAIM_CHUNK : chunk;
+        if (!sysfsWriteLong(path, chunk)) {
+            if (EAGAIN != errno) {
+                PWRMGR_LOG_ERRNO("Failed to write memory.reclaim");
+            }
+            break;
+        }
+        reclaimed += (uint64_t)chunk;
+    }
+    return reclaimed;
+}
+
+/**
+ * @brief Reset the statistics.
+ * Must be called before the worker thread is started.
+*/
+void powerMemoryInit(void)
+{
+    pthread_mutex_lock(&memory_mutex);
+    memset(&memory_stats, 0, sizeof(memory_stats));
+    pthread_mutex_unlock(&memory_mutex);
+}
+
+/**
+ * @brief Worker action: run the memory housekeeping of the target state.
+ * @param from The state being left.
+ * @param to The state being entered.
+ * @return true if every action completed within its budget.
+*/
+bool powerMemoryApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to)
+{
+    (void)from;
+    const MemoryAction_t *action = powerStatePolicy[to].memoryActions;
+    if (NULL == action || MEMORY_OP_END == action->op) {
+        return true;
+    }
+    uint64_t availableBefore = memoryAvailableKb();
+    uint64_t reclaimedBytes = 0;
+    uint32_t reclaimUs = 0;
+    uint32_t compactUs = 0;
+    uint32_t dropUs = 0;
+    uint32_t overruns = 0;
+
+    for (; MEMORY_OP_END != action->op; action++) {
+        uint64_t start = monotonicTimeUs();
+        uint64_t budgetUs = (uint64_t)action->budgetMs * 1000ULL;
+        switch (action->op) {
+            case MEMORY_OP_RECLAIM:
+                reclaimedBytes += memoryReclaim(action, start + budgetUs);
+                break;
+            case MEMORY_OP_COMPACT:
+                if (!sysfsWriteLong(VM_COMPACT_MEMORY_PATH, 1)) {
+                    PWRMGR_LOG_ERRNO("Failed to compact memory");
+                }
+                break;
+            case MEMORY_OP_DROP_CACHES:
+                if (!sysfsWriteLong(VM_DROP_CACHES_PATH, action->amount)) {
+                    PWRMGR_LOG_ERRNO("Failed to drop caches");
+                }
+                break;
+            default:
+                break;
+        }
+        uint64_t elapsed = monotonicTimeUs() - start;
+        if (elapsed > budgetUs) {
+            overruns++;
+        }
+        uint32_t *total = (MEMORY_OP_RECLAIM == action->op) ? &reclaimUs :
+                          (MEMORY_OP_COMPACT == action->op) ? &compactUs : &dropUs;
+        *total += (uint32_t)elapsed;
+    }
+
+    uint64_t availableAfter = memoryAvailableKb();
+    pthread_mutex_lock(&memory_mutex);
+    memory_stats.runCount++;
+    memory_stats.overrunCount += overruns;
+    memory_stats.lastReclaimedBytes = reclaimedBytes;
+    memory_stats.lastReclaimUs = reclaimUs;
+    memory_stats.lastCompactUs = compactUs;
+    memory_stats.lastDropCachesUs = dropUs;
+    memory_stats.lastAvailableBeforeKb = availableBefore;
+    memory_stats.lastAvailableAfterKb = availableAfter;
+    pthread_mutex_unlock(&memory_mutex);
+    PWRMGR_LOG_INFO("Reclaimed %llu bytes, MemAvailable %llu -> %llu kB, %u overruns",
+                     (unsigned long long)reclaimedBytes, (unsigned long long)availableBefore,
+                     (unsigned long long)availableAfter, overruns);
+    return 0 == overruns;
+}
+
+/**
+ * @brief Gets the memory housekeeping statistics.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_GetMemoryStats(PWRMgr_MemoryStats_t *stats)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (NULL == stats) {
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    if (pthread_mutex_lock(&memory_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_GET_FAILURE;
+    }
+    *stats = memory_stats;
+    pthread_mutex_unlock(&memory_mutex);
+    return PWRMGR_SUCCESS;
+}
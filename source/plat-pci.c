@@ -0,0 +1,191 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * PCIe link and device runtime PM. On the RPi4 the only PCIe device is the
+ * VL805 USB 3 controller behind the BCM2711 root port. States with a
+ * pcieAspmPolicy write it to the pcie_aspm module parameter, states with
+ * pciRuntimePm switch every PCI device's power/control to "auto"; the other
+ * states restore what was found at init. A transition is all or nothing: if
+ * any write fails, the ones already done are rolled back so the link and the
+ * devices never end up in a mix of two states.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "plat-power-priv.h"
+
+#define PCIE_ASPM_POLICY_PATH   "/sys/module/pcie_aspm/parameters/policy"
+#define PCI_MAX_DEVICES         16
+#define PCI_VALUE_MAX           24
+
+typedef struct {
+    char path[PWRMGR_PATH_MAX];     ///< power/control or the ASPM policy parameter
+    char baseline[PCI_VALUE_MAX];
+    char applied[PCI_VALUE_MAX];
+} PciNode_t;
+
+/* Only touched by the worker thread, or before it is started. */
+static PciNode_t pci_aspm;
+static bool pci_aspm_available = false;
+static PciNode_t pci_devices[PCI_MAX_DEVICES];
+static int pci_device_count = 0;
+
+/**
+ * @brief Extract the active policy from "default [performance] powersave ...".
+ * @return true if a bracketed entry was found.
+*/
+static bool pciParseAspmPolicy(const char *policies, char *policy, size_t size)
+{
+    const char *start = strchr(policies, '[');
+    const char *end = (NULL != start) ? strchr(start, ']') : NULL;
+    if (NULL == end) {
+        return false;
+    }
+    snprintf(policy, size, "%.*s", (int)(end - start - 1), start + 1);
+    return true;
+}
+
+static void pciAddDevice(const char *path, void *context)
+{
+    (void)context;
+    if (pci_device_count == PCI_MAX_DEVICES) {
+        PWRMGR_LOG_WARN("Too many PCI devices, ignoring '%s'", path);
+        return;
+    }
+    PciNode_t *device = &pci_devices[pci_device_count];
+    if (!powerShadowReadBaseline(path, device->baseline, device->applied, sizeof(device->baseline))) {
+        return;
+    }
+    snprintf(device->path, sizeof(device->path), "%s", path);
+    pci_device_count++;
+}
+
+/**
+ * @brief Write a value to a node unless it already holds it.
+ * @param changed Set if the node was written.
+ * @return true if successful.
+*/
+static bool pciWriteNode(PciNode_t *node, const char *value, bool *changed)
+{
+    *changed = false;
+    if (strcmp(node->applied, value) == 0) {
+        return true;
+    }
+    if (!sysfsWriteString(node->path, value)) {
+        PWRMGR_LOG_ERRNO("'%s' <- '%s' failed", node->path, value);
+        return false;
+    }
+    snprintf(node->applied, sizeof(node->applied), "%s", value);
+    *changed = true;
+    return true;
+}
+
+/**
+ * @brief Move the link and the devices to a policy, all or nothing.
+ * @param aspmPolicy The ASPM policy, NULL for the baseline.
+ * @param runtimePm Whether the devices may runtime suspend, false for the baseline.
+ * @return true if every write succeeded; false after rolling back.
+*/
+static bool pciApplyPolicy(const char *aspmPolicy, bool runtimePm)
+{
+    /* Index pci_device_count stands for the ASPM policy. */
+    char previous[PCI_MAX_DEVICES + 1][PCI_VALUE_MAX];
+    bool changed[PCI_MAX_DEVICES + 1] = { false };
+    int order[PCI_MAX_DEVICES + 1];
+    int count = 0;
+    bool success = true;
+
+    /* Devices suspend before the link powers down; the link is back before they resume. */
+    if (!runtimePm && pci_aspm_available) {
+        order[count++] = pci_device_count;
+    }
+    for (int i = 0; i < pci_device_count; i++) {
+        order[count++] = i;
+    }
+    if (runtimePm && pci_aspm_available) {
+        order[count++] = pci_device_count;
+    }
+    for (int step = 0; step < count && success; step++) {
+        int i = order[step];
+        PciNode_t *node = (i == pci_device_count) ? &pci_aspm : &pci_devices[i];
+        const char *value;
+        if (i == pci_device_count) {
+            value = (NULL != aspmPolicy) ? aspmPolicy : node->baseline;
+        } else {
+            value = runtimePm ? "auto" : node->baseline;
+        }
+        snprintf(previous[i], sizeof(previous[i]), "%s", node->applied);
+        success = pciWriteNode(node, value, &changed[i]);
+    }
+    if (success) {
+        return true;
+    }
+    for (int step = count - 1; step >= 0; step--) {
+        int i = order[step];
+        bool restored;
+        if (changed[i]) {
+            pciWriteNode((i == pci_device_count) ? &pci_aspm : &pci_devices[i], previous[i], &restored);
+        }
+    }
+    PWRMGR_LOG_ERROR("Rolled back to the previous policy");
+    return false;
+}
+
+/**
+ * @brief Snapshot the ASPM policy and the runtime PM control of the PCI devices.
+ * Must be called before the worker thread is started.
+*/
+void powerPciInit(void)
+{
+    char baselinePolicies[128] = {0};
+    char currentPolicies[128] = {0};
+    pci_device_count = 0;
+    pci_aspm_available = false;
+    if (powerShadowReadBaseline(PCIE_ASPM_POLICY_PATH, baselinePolicies, currentPolicies, sizeof(baselinePolicies)) &&
+        pciParseAspmPolicy(baselinePolicies, pci_aspm.baseline, sizeof(pci_aspm.baseline)) &&
+        pciParseAspmPolicy(currentPolicies, pci_aspm.applied, sizeof(pci_aspm.applied))) {
+        snprintf(pci_aspm.path, sizeof(pci_aspm.path), "%s", PCIE_ASPM_POLICY_PATH);
+        pci_aspm_available = true;
+    }
+    sysfsGlob("/sys/bus/pci/devices/*/power/control", pciAddDevice, NULL);
+    PWRMGR_LOG_INFO("ASPM policy '%s', %d PCI devices",
+                     pci_aspm_available ? pci_aspm.baseline : "unavailable", pci_device_count);
+}
+
+/**
+ * @brief Worker action: apply the PCIe ASPM and runtime PM policy of the target state.
+ * @param from The state being left.
+ * @param to The state being entered.
+ * @return true if successful, false if the previous policy was restored.
+*/
+bool powerPciApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to)
+{
+    (void)from;
+    return pciApplyPolicy(powerStatePolicy[to].pcieAspmPolicy, powerStatePolicy[to].pciRuntimePm);
+}
+
+/**
+ * @brief Restore the policy found at init.
+ * Must be called after the worker thread has been joined.
+*/
+void powerPciTerm(void)
+{
+    pciApplyPolicy(NULL, false);
+}
@@ -0,0 +1,252 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * RPi4 power policy tables.
+ * Warning: the hint figures are first estimates; finetune on target before relying on them.
+ */
+#include <linux/rfkill.h>
+
+#include "plat-power-priv.h"
+
+/*
+ * cgroup v2 settings of the background slice. Knobs not named by a state are
+ * restored to the value found at PLAT_INIT(). The UI slice cpu.uclamp.min is
+ * not listed here; it is combined with the hints through uiUclampMinPercent.
+ */
+static const CgroupSetting_t standbyCgroupSettings[] = {
+    { CGROUP_BACKGROUND_SLICE_PATH, "cpu.uclamp.max",   "30" },
+    { CGROUP_BACKGROUND_SLICE_PATH, "cpu.max",          "30000 100000" },
+    { NULL, NULL, NULL },
+};
+
+static const CgroupSetting_t lightSleepCgroupSettings[] = {
+    { CGROUP_BACKGROUND_SLICE_PATH, "cpu.uclamp.max",   "20" },
+    { CGROUP_BACKGROUND_SLICE_PATH, "cpu.max",          "20000 100000" },
+    { CGROUP_BACKGROUND_SLICE_PATH, "cpuset.cpus",      "0" },
+    { NULL, NULL, NULL },
+};
+
+static const CgroupSetting_t deepSleepCgroupSettings[] = {
+    { CGROUP_BACKGROUND_SLICE_PATH, "cpu.uclamp.max",   "10" },
+    { CGROUP_BACKGROUND_SLICE_PATH, "cpu.max",          "10000 100000" },
+    { CGROUP_BACKGROUND_SLICE_PATH, "cpuset.cpus",      "0" },
+    { NULL, NULL, NULL },
+};
+
+/*
+ * Memory housekeeping on entry to a standby state, run after the governor
+ * change. Reclaim stops at its budget; compaction and dropping caches cannot
+ * be interrupted, so their budgets only flag overruns in the statistics.
+ */
+static const MemoryAction_t standbyMemoryActions[] = {
+    { MEMORY_OP_RECLAIM,        CGROUP_BACKGROUND_SLICE_PATH,   64L << 20,  200 },
+    { MEMORY_OP_END,            NULL,                           0,          0 },
+};
+
+static const MemoryAction_t lightSleepMemoryActions[] = {
+    { MEMORY_OP_RECLAIM,        CGROUP_BACKGROUND_SLICE_PATH,   128L << 20, 300 },
+    { MEMORY_OP_RECLAIM,        CGROUP_APPS_SLICE_PATH,         64L << 20,  200 },
+    { MEMORY_OP_COMPACT,        NULL,                           0,          500 },
+    { MEMORY_OP_END,            NULL,                           0,          0 },
+};
+
+static const MemoryAction_t deepSleepMemoryActions[] = {
+    { MEMORY_OP_RECLAIM,        CGROUP_BACKGROUND_SLICE_PATH,   256L << 20, 500 },
+    { MEMORY_OP_RECLAIM,        CGROUP_APPS_SLICE_PATH,         256L << 20, 500 },
+    /* Page cache only; the hot UI pages come back through the resume prefetch. */
+    { MEMORY_OP_DROP_CACHES,    NULL,                           1,          300 },
+    { MEMORY_OP_COMPACT,        NULL,                           0,          1000 },
+    { MEMORY_OP_END,            NULL,                           0,          0 },
+};
+
+/*
+ * VM writeback knobs. Knobs not named by a state are restored to the value
+ * found at PLAT_INIT(). The standby states batch dirty data laptop-mode style
+ * so the flusher wakes the SD card rarely; a power cut there loses at most
+ * the expire interval. OFF writes back eagerly so the final sync is short.
+ */
+static const VmSetting_t offVmSettings[] = {
+    { "dirty_writeback_centisecs",  100 },
+    { "dirty_expire_centisecs",     100 },
+    { "dirty_background_ratio",     1 },
+    { NULL, 0 },
+};
+
+static const VmSetting_t standbyVmSettings[] = {
+    { "dirty_writeback_centisecs",  3000 },
+    { "dirty_expire_centisecs",     3000 },
+    { NULL, 0 },
+};
+
+static const VmSetting_t sleepVmSettings[] = {
+    { "dirty_writeback_centisecs",  6000 },
+    { "dirty_expire_centisecs",     6000 },
+    { "dirty_ratio",                40 },
+    { "dirty_background_ratio",     20 },
+    { "laptop_mode",                5 },
+    { NULL, 0 },
+};
+
+/**
+ * @brief cgroups the freezer may stop, in thaw order: the UI runs again first.
+ * Frozen in the reverse order. NULL terminated, at most 32 entries.
+ */
+const char *const powerFreezerCgroups[] = {
+    CGROUP_UI_SLICE_PATH,
+    CGROUP_APPS_SLICE_PATH,
+    CGROUP_BACKGROUND_SLICE_PATH,
+    NULL,
+};
+
+/**
+ * @brief Per power state policy, indexed by PWRMgr_PowerState_t.
+ */
+const PowerStatePolicy_t powerStatePolicy[PWRMGR_POWERSTATE_MAX] = {
+    [PWRMGR_POWERSTATE_OFF] = {
+        .governor = NULL,
+        .vmSettings = offVmSettings,
+    },
+    [PWRMGR_POWERSTATE_STANDBY] = {
+        .governor = "conservative",
+        /* Housekeeping on cpu0 only, so cpu1-3 reach their deepest idle state. */
+        .housekeepingCpuMask = 0x1,
+        /* UI and apps stop; background maintenance keeps running, throttled. */
+        .frozenCgroupMask = 0x3,
+        .cgroupSettings = standbyCgroupSettings,
+        .memoryActions = standbyMemoryActions,
+        .displayBlank = true,
+        .usbAutosuspendDelayMs = 2000,
+        .pcieAspmPolicy = "powersave",
+        .pciRuntimePm = true,
+        .vmSettings = standbyVmSettings,
+    },
+    [PWRMGR_POWERSTATE_ON] = {
+        .governor = "performance",
+        /* Keep the audio path clear of deep idle exit latencies: state0-1 only. */
+        .cpuidleDisableMask = ~0x3U,
+        .cpuDmaLatencyUs = 100,
+        .uiUclampMinPercent = 20,
+        /* ASPM exit latency shows up as USB 3 storage and camera stutter. */
+        .pcieAspmPolicy = "performance",
+    },
+    [PWRMGR_POWERSTATE_STANDBY_LIGHT_SLEEP] = {
+        .governor = "ondemand",
+        .housekeepingCpuMask = 0x1,
+        .frozenCgroupMask = 0x3,
+        .cgroupSettings = lightSleepCgroupSettings,
+        .memoryActions = lightSleepMemoryActions,
+        .displayBlank = true,
+        .usbAutosuspendDelayMs = 1000,
+        .pcieAspmPolicy = "powersave",
+        .pciRuntimePm = true,
+        .vmSettings = sleepVmSettings,
+    },
+    [PWRMGR_POWERSTATE_STANDBY_DEEP_SLEEP] = {
+        .governor = "schedutil",
+        /* Park cpu1-3; the resume cost is reported by PLAT_API_GetCpuHotplugStats(). */
+        .onlineCpuMask = 0x1,
+        .housekeepingCpuMask = 0x1,
+        .frozenCgroupMask = 0x7,
+        .cgroupSettings = deepSleepCgroupSettings,
+        .memoryActions = deepSleepMemoryActions,
+        .displayBlank = true,
+        /* Wi-Fi and Bluetooth off unless armed as wakeup sources. */
+        .rfkillBlockMask = (1U << RFKILL_TYPE_WLAN) | (1U << RFKILL_TYPE_BLUETOOTH),
+        .usbAutosuspendDelayMs = 500,
+        /* L1 substates as well; the VL805 is idle once USB has autosuspended. */
+        .pcieAspmPolicy = "powersupersave",
+        .pciRuntimePm = true,
+        .vmSettings = sleepVmSettings,
+    },
+};
+
+/**
+ * @brief Files the UI touches first on resume, as glob(3) patterns. Their
+ * resident pages are recorded on leaving ON and read back in ahead of ON.
+ */
+const char *const powerPrefetchFiles[] = {
+    "/usr/bin/WPEFramework",
+    "/usr/lib/wpeframework/plugins/*.so",
+    "/usr/lib/libWPEWebKit*.so*",
+    NULL,
+};
+
+/**
+ * @brief USB devices (idVendor:idProduct) autosuspended in standby. When the
+ * allow list is empty every device not denied and not armed for wakeup is.
+ * NULL terminated.
+ */
+const char *const powerUsbAllowList[] = {
+    NULL,
+};
+
+/**
+ * @brief USB devices never autosuspended, whatever the allow list says.
+ */
+const char *const powerUsbDenyList[] = {
+    "20a0:0006",    /* flirc IR receiver: drops keys while resuming */
+    NULL,
+};
+
+/**
+ * @brief Predictive pre-wake policy.
+ */
+const PowerPrewakePolicy_t powerPrewakePolicy = {
+    .leadSec = 300,
+    .minObservations = 3,
+    .minFreqPercent = 60,
+    .thawCgroupMask = 0x1,
+};
+
+/**
+ * @brief Per workload hint policy, indexed by PWRMgr_PowerHint_t.
+ * When several hints are active the governor of the lowest index wins,
+ * frequency floor and uclamp take the maximum.
+ */
+const PowerHintPolicy_t powerHintPolicy[PWRMGR_HINT_MAX] = {
+    [PWRMGR_HINT_APP_LAUNCH] = {
+        .name = "APP_LAUNCH",
+        .governor = "performance",
+        .minFreqPercent = 100,
+        .uclampMinPercent = 100,
+        .maxDurationMs = 10000,
+    },
+    [PWRMGR_HINT_VIDEO_DECODE] = {
+        .name = "VIDEO_DECODE",
+        .governor = NULL,
+        .minFreqPercent = 60,
+        .uclampMinPercent = 50,
+        .maxDurationMs = 600000,
+    },
+    [PWRMGR_HINT_INTERACTION] = {
+        .name = "INTERACTION",
+        .governor = NULL,
+        .minFreqPercent = 50,
+        .uclampMinPercent = 40,
+        .maxDurationMs = 3000,
+    },
+    [PWRMGR_HINT_BACKGROUND_MAINTENANCE] = {
+        .name = "BACKGROUND_MAINTENANCE",
+        .governor = "ondemand",
+        .minFreqPercent = -1,
+        .uclampMinPercent = -1,
+        .maxDurationMs = 1800000,
+    },
+};
@@ -0,0 +1,336 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * @file plat-power-priv.h
+ * @brief Internal interfaces shared between the Power Manager HAL modules.
+ */
+
+#ifndef __PLAT_POWER_PRIV_H__
+#define __PLAT_POWER_PRIV_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdatomic.h>
+
+#include "plat_power.h"
+#include "plat_power_ext.h"
+
+/*
+ * All kernel interface paths (/sys, /proc, /dev) are resolved against an
+ * optional root taken from this environment variable, so the HAL can be
+ * exercised against a simulated tree without touching the real hardware.
+ */
+#define PWRMGR_SYSFS_ROOT_ENV           "PWRMGR_SYSFS_ROOT"
+
+#define CPU_FREQ_SCALING_GOVERNOR_PATH  "/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor"
+#define CPU_FREQ_SCALING_MIN_FREQ_PATH  "/sys/devices/system/cpu/cpu0/cpufreq/scaling_min_freq"
+#define CPU_FREQ_CPUINFO_MIN_FREQ_PATH  "/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_min_freq"
+#define CPU_FREQ_CPUINFO_MAX_FREQ_PATH  "/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq"
+
+/* cgroup v2 slices the policy tables steer; missing slices are skipped. */
+#define CGROUP_UI_SLICE_PATH            "/sys/fs/cgroup/ui.slice"
+#define CGROUP_APPS_SLICE_PATH          "/sys/fs/cgroup/apps.slice"
+#define CGROUP_BACKGROUND_SLICE_PATH    "/sys/fs/cgroup/background.slice"
+
+#define PWRMGR_PATH_MAX                 256
+#define PWRMGR_MAX_CPUS                 32
+
+/* plat-sysfs.c */
+const char *sysfsRoot(void);
+bool sysfsResolvePath(const char *path, char *resolved, size_t size);
+bool sysfsReadString(const char *path, char *value, size_t size);
+bool sysfsWriteString(const char *path, const char *value);
+bool sysfsReadLong(const char *path, long *value);
+bool sysfsWriteLong(const char *path, long value);
+int sysfsGlob(const char *pattern, void (*callback)(const char *path, void *context), void *context);
+uint64_t monotonicTimeMs(void);
+uint64_t monotonicTimeUs(void);
+
+/* plat-log.c */
+#define PWRMGR_LOG_FILE_ENV             "PWRMGR_LOG_FILE"
+#define PWRMGR_LOG_LEVEL_ENV            "PWRMGR_LOG_LEVEL"
+
+/* Rate limit of a single call site: burst messages per interval, the rest counted. */
+#define PWRMGR_LOG_BURST                10
+#define PWRMGR_LOG_INTERVAL_MS          1000
+
+typedef struct {
+    const char *func;
+    int line;
+    _Atomic uint64_t windowStartMs;
+    atomic_uint count;
+    atomic_uint suppressed;
+} PowerLogSite_t;
+
+extern atomic_int powerLogLevel;
+
+void powerLogInit(void);
+void powerLogTerm(void);
+void powerLogFlush(void);
+void powerLogWrite(PowerLogSite_t *site, PWRMgr_LogLevel_t level, int errnum, const char *format, ...)
+        __attribute__((format(printf, 4, 5)));
+
+/*
+ * Every call site owns a static PowerLogSite_t for its rate limit and
+ * location fields. Messages above the current level cost one atomic load.
+ */
+#define PWRMGR_LOG(level, errnum, ...) \
+    do { \
+        static PowerLogSite_t powerLogSite = { __func__, __LINE__, 0, 0, 0 }; \
+        if ((int)(level) <= atomic_load_explicit(&powerLogLevel, memory_order_relaxed)) { \
+            powerLogWrite(&powerLogSite, (level), (errnum), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define PWRMGR_LOG_ERROR(...)   PWRMGR_LOG(PWRMGR_LOGLEVEL_ERROR, 0, __VA_ARGS__)
+#define PWRMGR_LOG_ERRNO(...)   PWRMGR_LOG(PWRMGR_LOGLEVEL_ERROR, errno, __VA_ARGS__)
+#define PWRMGR_LOG_WARN(...)    PWRMGR_LOG(PWRMGR_LOGLEVEL_WARN, 0, __VA_ARGS__)
+#define PWRMGR_LOG_INFO(...)    PWRMGR_LOG(PWRMGR_LOGLEVEL_INFO, 0, __VA_ARGS__)
+#define PWRMGR_LOG_DEBUG(...)   PWRMGR_LOG(PWRMGR_LOGLEVEL_DEBUG, 0, __VA_ARGS__)
+
+/* plat-power.c */
+bool getCPUFreqScalingGovernor(char *governor, size_t size);
+bool setCPUFreqScalingGovernor(const char *governor);
+char *rdkPowerStateToString(PWRMgr_PowerState_t state);
+bool powerMgrIsInitialized(void);
+bool powerMgrWakeWorker(void);
+pmStatus_t powerMgrRequestState(PWRMgr_PowerState_t newState);
+void powerMgrRequestAutomatic(PWRMgr_PowerState_t expected, PWRMgr_PowerState_t newState);
+
+/* plat-policy.c */
+typedef struct {
+    const char *cgroup;         ///< cgroup v2 directory, NULL terminates a list
+    const char *file;           ///< Interface file inside the cgroup
+    const char *value;          ///< Value written on entry to the state
+} CgroupSetting_t;
+
+typedef struct {
+    const char *file;           ///< Knob under /proc/sys/vm, NULL terminates a list
+    long value;                 ///< Value written on entry to the state
+} VmSetting_t;
+
+typedef enum {
+    MEMORY_OP_END = 0,          ///< Terminates a list
+    MEMORY_OP_RECLAIM,          ///< Write <cgroup>/memory.reclaim
+    MEMORY_OP_COMPACT,          ///< Write /proc/sys/vm/compact_memory
+    MEMORY_OP_DROP_CACHES,      ///< Write /proc/sys/vm/drop_caches
+} PowerMemoryOp_t;
+
+typedef struct {
+    PowerMemoryOp_t op;
+    const char *cgroup;         ///< cgroup v2 directory for MEMORY_OP_RECLAIM
+    long amount;                ///< Bytes to reclaim, or the drop_caches level
+    uint32_t budgetMs;          ///< Time the action may take
+} MemoryAction_t;
+
+typedef struct {
+    const char *governor;       ///< cpufreq governor applied on entry to the state
+    uint32_t onlineCpuMask;     ///< CPUs kept online, 0 for all present CPUs
+    uint32_t housekeepingCpuMask;///< CPUs running unbound workqueues and IRQs, 0 for the baseline
+    uint32_t cpuidleDisableMask;///< Idle states disabled (bit n = stateN), on top of the baseline
+    int32_t cpuDmaLatencyUs;    ///< Wakeup latency bound held via /dev/cpu_dma_latency, 0 for none
+    int uiUclampMinPercent;     ///< cpu.uclamp.min of the UI slice, 0 for the baseline
+    uint32_t frozenCgroupMask;  ///< Entries of powerFreezerCgroups[] frozen (bit n = entry n)
+    const CgroupSetting_t *cgroupSettings; ///< Other cgroup knobs, baseline if not named
+    const MemoryAction_t *memoryActions;   ///< Housekeeping run on entry, in order
+    const VmSetting_t *vmSettings;         ///< VM writeback knobs, baseline if not named
+    uint32_t usbAutosuspendDelayMs;        ///< Autosuspend delay of managed USB devices, 0 for the baseline
+    const char *pcieAspmPolicy;            ///< pcie_aspm policy, NULL for the baseline
+    bool pciRuntimePm;                     ///< Let PCI devices runtime suspend (power/control "auto")
+    bool displayBlank;                     ///< Power the framebuffers down (FB_BLANK_POWERDOWN)
+    uint32_t rfkillBlockMask;              ///< Radio types soft blocked (bit n = RFKILL_TYPE_n), 0 for none
+} PowerStatePolicy_t;
+
+typedef struct {
+    const char *name;
+    const char *governor;       ///< Governor override, NULL to keep the state governor
+    int minFreqPercent;         ///< Floor as a percentage of the cpuinfo range, -1 to keep
+    int uclampMinPercent;       ///< cpu.uclamp.min of the UI slice, -1 to keep
+    uint32_t maxDurationMs;     ///< Upper bound of a single reference
+} PowerHintPolicy_t;
+
+typedef struct {
+    uint32_t leadSec;           ///< How long before a likely wake hour to pre-wake
+    uint16_t minObservations;   ///< ON transitions in an hour-of-week bin to call it likely
+    int minFreqPercent;         ///< CPU frequency floor while pre-woken, -1 for none
+    uint32_t thawCgroupMask;    ///< Entries of powerFreezerCgroups[] thawed while pre-woken
+} PowerPrewakePolicy_t;
+
+extern const PowerStatePolicy_t powerStatePolicy[PWRMGR_POWERSTATE_MAX];
+extern const PowerHintPolicy_t powerHintPolicy[PWRMGR_HINT_MAX];
+extern const char *const powerFreezerCgroups[];
+extern const PowerPrewakePolicy_t powerPrewakePolicy;
+extern const char *const powerPrefetchFiles[];
+extern const char *const powerUsbAllowList[];
+extern const char *const powerUsbDenyList[];
+
+/* plat-hint.c */
+void powerHintInit(void);
+void powerHintTerm(void);
+uint64_t powerHintNextDeadline(void);
+void powerHintApply(PWRMgr_PowerState_t state, bool stateChanged);
+int powerHintFloorPercent(void);
+
+/* plat-cpuhotplug.c */
+void powerCpuHotplugInit(void);
+void powerCpuHotplugTerm(void);
+bool powerCpuHotplugApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to);
+
+/* plat-cgroup.c */
+void powerCgroupInit(void);
+void powerCgroupTerm(void);
+bool powerCgroupApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to);
+
+/* plat-cpuidle.c */
+void powerCpuidleInit(void);
+void powerCpuidleTerm(void);
+bool powerCpuidleApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to);
+
+/* plat-wakeup.c */
+void powerWakeupInit(void);
+bool powerWakeupIsSupported(PWRMGR_WakeupSrcType_t srcType);
+bool powerWakeupIsEnabled(PWRMGR_WakeupSrcType_t srcType);
+pmStatus_t powerWakeupSet(PWRMGR_WakeupSrcType_t srcType, bool enable);
+
+/* plat-alarm.c */
+void powerAlarmInit(void);
+void powerAlarmTerm(void);
+void powerAlarmSync(void);
+uint64_t powerAlarmNextDeadline(void);
+bool powerAlarmExpire(void);
+void powerAlarmSetPrewake(time_t wakeTime);
+
+/* plat-freezer.c */
+void powerFreezerInit(void);
+void powerFreezerTerm(void);
+bool powerFreezerApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to);
+bool powerFreezerSuspend(void);
+void powerFreezerResume(void);
+void powerFreezerSetPrewake(uint32_t thawMask);
+
+/* plat-memory.c */
+void powerMemoryInit(void);
+bool powerMemoryApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to);
+
+/* plat-affinity.c */
+void powerAffinityInit(void);
+void powerAffinityTerm(void);
+bool powerAffinityApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to);
+
+/* plat-usb.c */
+void powerUsbInit(void);
+void powerUsbTerm(void);
+bool powerUsbApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to);
+
+/* plat-display.c */
+void powerDisplayInit(void);
+void powerDisplayTerm(void);
+bool powerDisplayApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to);
+
+/* plat-rfkill.c */
+void powerRfkillInit(void);
+void powerRfkillTerm(void);
+bool powerRfkillApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to);
+
+/* plat-pci.c */
+void powerPciInit(void);
+void powerPciTerm(void);
+bool powerPciApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to);
+
+/* plat-writeback.c */
+void powerWritebackInit(void);
+void powerWritebackTerm(void);
+bool powerWritebackApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to);
+
+/* plat-prefetch.c */
+void powerPrefetchInit(void);
+void powerPrefetchTerm(void);
+bool powerPrefetchApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to);
+void powerPrefetchStart(void);
+
+/* plat-prewake.c */
+void powerPrewakeInit(void);
+void powerPrewakeTerm(void);
+bool powerPrewakeApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to);
+void powerPrewakeRecordWake(PWRMgr_PowerState_t from);
+uint64_t powerPrewakeNextDeadline(void);
+void powerPrewakeService(PWRMgr_PowerState_t state);
+
+/* plat-escalation.c */
+void powerEscalationInit(void);
+void powerEscalationArm(PWRMgr_PowerState_t state);
+void powerEscalationCancel(void);
+uint64_t powerEscalationNextDeadline(void);
+bool powerEscalationExpire(PWRMgr_PowerState_t *target);
+
+/* plat-suspend.c */
+void powerSuspendInit(void);
+bool powerSuspendIsEnabled(void);
+bool powerSuspendToIdle(void);
+void powerSuspendResumeComplete(void);
+
+/* plat-shutdown.c */
+bool powerShutdownPrepare(void);
+void powerShutdownAbort(void);
+
+/* plat-kexec.c */
+typedef struct {
+    long (*kexecFileLoad)(int kernelFd, int initrdFd, unsigned long cmdlineLen,
+                          const char *cmdline, unsigned long flags);
+    int (*reboot)(int cmd);
+} PowerKexecOps_t;
+
+void powerKexecInit(void);
+void powerKexecTerm(void);
+bool powerKexecReboot(void);
+void powerKexecSetOps(const PowerKexecOps_t *ops);
+
+/* plat-journal.c */
+void powerJournalInit(void);
+void powerJournalTerm(void);
+void powerJournalAppend(PWRMgr_JournalKind_t kind, PWRMgr_PowerState_t from, PWRMgr_PowerState_t to,
+                        bool success, uint32_t latencyUs, bool flush);
+
+/* plat-shadow.c */
+void powerShadowInit(void);
+void powerShadowTerm(void);
+bool powerShadowRestoredState(PWRMgr_PowerState_t *state);
+bool powerShadowReadBaseline(const char *path, char *baseline, char *current, size_t size);
+bool powerShadowReadBaselineLong(const char *path, long *baseline, long *current);
+void powerShadowCommit(void);
+void powerShadowStoreState(PWRMgr_PowerState_t state);
+
+/* plat-uevent.c */
+void powerUeventInit(void);
+void powerUeventTerm(void);
+int powerUeventFd(void);
+void powerUeventService(PWRMgr_PowerState_t state);
+
+/* plat-qos.c */
+#define PWRMGR_QOS_MAX_REQUESTS         64
+
+void powerQosInit(void);
+void powerQosTerm(void);
+void powerQosApply(void);
+void powerQosSetStateLatency(int32_t latencyUs);
+
+#endif /* __PLAT_POWER_PRIV_H__ */
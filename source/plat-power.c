@@ -19,24 +19,45 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/reboot.h>
+#include <sys/timerfd.h>
 #include <linux/reboot.h>
 
 #include "plat_power.h"
+#include "plat-power-priv.h"
 
 #define PWRHALVERSION "1.2.0"
 
+/* The worker only runs the action table and short sysfs accesses. */
+#define WORKER_STACK_SIZE   (128 * 1024)
+#define WORKER_MAX_EVENTS   4
+
+/* epoll_event.data of the worker's event sources. */
+typedef enum {
+    WORKER_EVENT_REQUEST = 0,       ///< eventfd: state request, hint, QoS, alarm or stop
+    WORKER_EVENT_TIMER,             ///< timerfd: the earliest deadline of powerMgrNextDeadline()
+    WORKER_EVENT_UEVENT,            ///< Kernel device events
+} WorkerEvent_t;
+
 static PWRMgr_PowerState_t power_state;
+static bool power_state_pending = false;
+static bool power_state_automatic = false;
 static pmStatus_t powerMgrStatus = PWRMGR_NOT_INITIALIZED;
 
 pthread_t worker_thread;
 pthread_mutex_t power_state_mutex = PTHREAD_MUTEX_INITIALIZER;
-sem_t power_state_semaphore;
 int thread_running = 1;
 
+static int worker_epoll_fd = -1;
+static int worker_event_fd = -1;
+static int worker_timer_fd = -1;
+
 // RPi4 Specific tunings. These are the options for the CPU frequency scaling governor:
 // conservative, ondemand, userspace, powersave, performance, schedutil
 /***
@@ -69,7 +90,6 @@ schedutil:
     Aims to provide a balance between performance and power saving based on real-time system load.
     Generally considered more efficient and responsive compared to other governors.
 */
-#define CPU_FREQ_SCALING_GOVERNOR_PATH "/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor"
 
 /**
  * @brief Get the CPU frequency scaling governor.
@@ -80,21 +100,22 @@ schedutil:
 bool getCPUFreqScalingGovernor(char *governor, size_t size)
 {
     char buffer[32] = {0};
-    if (NULL == governor) {
+    char path[PWRMGR_PATH_MAX];
+    if (NULL == governor || !sysfsResolvePath(CPU_FREQ_SCALING_GOVERNOR_PATH, path, sizeof(path))) {
         return false;
     }
-    FILE *fp = fopen(CPU_FREQ_SCALING_GOVERNOR_PATH, "r");
+    FILE *fp = fopen(path, "r");
     if (fp == NULL) {
-        perror("Failed to open CPU frequency scaling governor file");
+        PWRMGR_LOG_ERRNO("Failed to open CPU frequency scaling governor file");
         return false;
     }
     if (fgets(buffer, sizeof(buffer), fp) == NULL) {
-        perror("Failed to read CPU frequency scaling governor file");
+        PWRMGR_LOG_ERRNO("Failed to read CPU frequency scaling governor file");
         fclose(fp);
         return false;
     }
     fclose(fp);
-    printf("CPU frequency scaling governor: '%s'\n", buffer);
+    PWRMGR_LOG_DEBUG("CPU frequency scaling governor: '%s'", buffer);
     snprintf(governor, size, "%s", buffer);
     return true;
 }
@@ -107,7 +128,8 @@ bool getCPUFreqScalingGovernor(char *governor, size_t size)
 */
 bool setCPUFreqScalingGovernor(const char *governor)
 {
-    if (NULL == governor) {
+    char path[PWRMGR_PATH_MAX];
+    if (NULL == governor || !sysfsResolvePath(CPU_FREQ_SCALING_GOVERNOR_PATH, path, sizeof(path))) {
         return false;
     }
     if ((strcmp(governor, "conservative") != 0) &&
@@ -116,16 +138,16 @@ bool setCPUFreqScalingGovernor(const char *governor)
         (strcmp(governor, "powersave") != 0) &&
         (strcmp(governor, "performance") != 0) &&
         (strcmp(governor, "schedutil") != 0)) {
-        printf("Invalid CPU frequency scaling governor: '%s'\n", governor);
+        PWRMGR_LOG_ERROR("Invalid CPU frequency scaling governor: '%s'", governor);
         return false;
     }
-    FILE *fp = fopen(CPU_FREQ_SCALING_GOVERNOR_PATH, "w");
+    FILE *fp = fopen(path, "w");
     if (fp == NULL) {
-        perror("Failed to open CPU frequency scaling governor file");
+        PWRMGR_LOG_ERRNO("Failed to open CPU frequency scaling governor file");
         return false;
     }
     if (fputs(governor, fp) == EOF) {
-        perror("Failed to write CPU frequency scaling governor file");
+        PWRMGR_LOG_ERRNO("Failed to write CPU frequency scaling governor file");
         fclose(fp);
         return false;
     }
@@ -156,9 +178,289 @@ char * rdkPowerStateToString(PWRMgr_PowerState_t state)
     }
 }
 
+/**
+ * @brief Check whether PLAT_INIT() has completed.
+ * @return true if the HAL is initialized.
+*/
+bool powerMgrIsInitialized(void)
+{
+    return (PWRMGR_ALREADY_INITIALIZED == powerMgrStatus);
+}
+
+/**
+ * @brief Wake the worker thread without requesting a power state change.
+ * @return true if successful.
+*/
+bool powerMgrWakeWorker(void)
+{
+    uint64_t one = 1;
+    if (write(worker_event_fd, &one, sizeof(one)) != sizeof(one)) {
+        PWRMGR_LOG_ERRNO("Failed to signal worker");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Arm the worker timer for a deadline.
+ * @param deadline Monotonic deadline in ms, 0 to disarm.
+*/
+static void powerMgrArmTimer(uint64_t deadline)
+{
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    /* A deadline already passed fires at once; 0 stays disarmed. */
+    spec.it_value.tv_sec = (time_t)(deadline / 1000);
+    spec.it_value.tv_nsec = (long)(deadline % 1000) * 1000000L;
+    if (timerfd_settime(worker_timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to arm worker timer");
+    }
+}
+
+/**
+ * @brief Block until at least one event source fires and consume its events.
+ * @param applied_state The power state currently applied by the worker.
+ * @return false if the event loop failed.
+*/
+static bool powerMgrWaitForEvents(PWRMgr_PowerState_t applied_state)
+{
+    struct epoll_event events[WORKER_MAX_EVENTS];
+    uint64_t counter;
+    int count = epoll_wait(worker_epoll_fd, events, WORKER_MAX_EVENTS, -1);
+    if (count < 0) {
+        if (EINTR == errno) {
+            return true;
+        }
+        PWRMGR_LOG_ERRNO("Failed to wait for events");
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        switch (events[i].data.u32) {
+            case WORKER_EVENT_REQUEST:
+                /* Requests coalesce; the pending state is read under the mutex. */
+                if (read(worker_event_fd, &counter, sizeof(counter)) < 0 && EAGAIN != errno) {
+                    PWRMGR_LOG_ERRNO("Failed to read worker requests");
+                }
+                break;
+            case WORKER_EVENT_TIMER:
+                if (read(worker_timer_fd, &counter, sizeof(counter)) < 0 && EAGAIN != errno) {
+                    PWRMGR_LOG_ERRNO("Failed to read worker timer");
+                }
+                break;
+            case WORKER_EVENT_UEVENT:
+                powerUeventService(applied_state);
+                break;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Close the worker's event sources.
+ * Must be called after the worker thread has been joined.
+*/
+static void powerMgrEventLoopTerm(void)
+{
+    int *fds[] = { &worker_epoll_fd, &worker_event_fd, &worker_timer_fd };
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        if (*fds[i] >= 0) {
+            close(*fds[i]);
+            *fds[i] = -1;
+        }
+    }
+}
+
+/**
+ * @brief Create the worker's event sources.
+ * @return true if successful; nothing is left open otherwise.
+*/
+static bool powerMgrEventLoopInit(void)
+{
+    struct epoll_event event;
+    worker_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    worker_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    worker_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    bool success = worker_epoll_fd >= 0 && worker_event_fd >= 0 && worker_timer_fd >= 0;
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u32 = WORKER_EVENT_REQUEST;
+    success = success && epoll_ctl(worker_epoll_fd, EPOLL_CTL_ADD, worker_event_fd, &event) == 0;
+    event.data.u32 = WORKER_EVENT_TIMER;
+    success = success && epoll_ctl(worker_epoll_fd, EPOLL_CTL_ADD, worker_timer_fd, &event) == 0;
+    if (success && powerUeventFd() >= 0) {
+        event.data.u32 = WORKER_EVENT_UEVENT;
+        if (epoll_ctl(worker_epoll_fd, EPOLL_CTL_ADD, powerUeventFd(), &event) != 0) {
+            PWRMGR_LOG_ERRNO("Failed to watch uevents");
+        }
+    }
+    if (!success) {
+        PWRMGR_LOG_ERRNO("Failed to create the worker event loop");
+        powerMgrEventLoopTerm();
+    }
+    return success;
+}
+
+/**
+ * @brief Worker action: set the CPU frequency scaling governor of the policy table.
+ * @param from The state being left.
+ * @param to The state being entered.
+ * @return true if successful or no governor is configured, false otherwise.
+*/
+static bool powerMgrApplyGovernor(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to)
+{
+    char current[32] = {0};
+    const char *governor = powerStatePolicy[to].governor;
+    /* Only a reconcile pass stays in the same state; skip the write if nothing changed. */
+    if (NULL != governor && from == to && getCPUFreqScalingGovernor(current, sizeof(current))) {
+        current[strcspn(current, "\n")] = '\0';
+        if (strcmp(current, governor) == 0) {
+            return true;
+        }
+    }
+    if (NULL != governor && !setCPUFreqScalingGovernor(governor)) {
+        PWRMGR_LOG_ERROR("Failed to set CPU frequency scaling governor to '%s'", governor);
+        return false;
+    }
+    return true;
+}
+
+typedef struct {
+    const char *name;
+    bool (*apply)(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to);
+    bool reconcile;             ///< Run when a restarted HAL reconciles the restored state
+} PowerAction_t;
+
+/**
+ * Worker action table in power-down order. Transitions to ON run it in
+ * reverse, so e.g. parked cores are back online before the governor switch
+ * and the display only lights up once everything behind it is running.
+ * Actions that are one-shot work on entering a state rather than settings
+ * are left out of the reconcile pass.
+ */
+static const PowerAction_t powerActions[] = {
+    { "display",        powerDisplayApply,      true },
+    { "prefetch",       powerPrefetchApply,     false },
+    { "prewake",        powerPrewakeApply,      false },
+    { "freezer",        powerFreezerApply,      true },
+    { "cgroup",         powerCgroupApply,       true },
+    { "cpuidle",        powerCpuidleApply,      true },
+    { "governor",       powerMgrApplyGovernor,  true },
+    { "writeback",      powerWritebackApply,    true },
+    { "memory",         powerMemoryApply,       false },
+    { "affinity",       powerAffinityApply,     true },
+    { "usb",            powerUsbApply,          true },
+    { "pci",            powerPciApply,          true },
+    { "cpu-hotplug",    powerCpuHotplugApply,   true },
+    { "rfkill",         powerRfkillApply,       true },
+};
+
+/**
+ * @brief Run the worker action table for a state transition.
+ * @param from The state being left.
+ * @param to The state being entered; equal to from for a reconcile pass.
+ * @return true if every action succeeded.
+*/
+static bool powerMgrRunActions(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to)
+{
+    const size_t count = sizeof(powerActions) / sizeof(powerActions[0]);
+    bool resume = (PWRMGR_POWERSTATE_ON == to);
+    bool reconcile = (from == to);
+    bool allDone = true;
+    for (size_t i = 0; i < count; i++) {
+        const PowerAction_t *action = &powerActions[resume ? (count - 1 - i) : i];
+        if (reconcile && !action->reconcile) {
+            continue;
+        }
+        uint64_t start = monotonicTimeUs();
+        bool success = action->apply(from, to);
+        PWRMGR_LOG_DEBUG("Action '%s' %s in %llu us", action->name,
+                          success ? "done" : "failed", (unsigned long long)(monotonicTimeUs() - start));
+        allDone = allDone && success;
+    }
+    return allDone;
+}
+
+/**
+ * @brief Request a state change on the worker's own initiative.
+ * An explicit request that is still pending, or that already moved the
+ * state away from the expected one, takes precedence.
+ * @param expected The state the decision was based on.
+ * @param newState The state to move to.
+*/
+void powerMgrRequestAutomatic(PWRMgr_PowerState_t expected, PWRMgr_PowerState_t newState)
+{
+    if (pthread_mutex_lock(&power_state_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return;
+    }
+    bool superseded = power_state_pending || power_state != expected;
+    if (!superseded) {
+        power_state = newState;
+        power_state_pending = true;
+        power_state_automatic = true;
+    }
+    if (pthread_mutex_unlock(&power_state_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to unlock mutex");
+    }
+    if (!superseded) {
+        powerMgrWakeWorker();
+    }
+}
+
+/**
+ * @brief Get the earliest deadline the worker has to wake up for.
+ * @return The deadline in monotonic ms, 0 if there is none.
+*/
+static uint64_t powerMgrNextDeadline(void)
+{
+    uint64_t deadlines[] = {
+        powerHintNextDeadline(), powerAlarmNextDeadline(), powerEscalationNextDeadline(), powerPrewakeNextDeadline()
+    };
+    uint64_t earliest = 0;
+    for (size_t i = 0; i < sizeof(deadlines) / sizeof(deadlines[0]); i++) {
+        if (deadlines[i] != 0 && (earliest == 0 || deadlines[i] < earliest)) {
+            earliest = deadlines[i];
+        }
+    }
+    return earliest;
+}
+
+/**
+ * @brief Service everything that is not a state change: hints, QoS and wake alarms.
+ * @param applied_state The power state currently applied by the worker.
+*/
+static void powerMgrService(PWRMgr_PowerState_t applied_state)
+{
+    PWRMgr_PowerState_t target;
+    powerPrewakeService(applied_state);
+    powerHintApply(applied_state, false);
+    powerQosApply();
+    if (powerAlarmExpire() && (PWRMGR_POWERSTATE_STANDBY_LIGHT_SLEEP == applied_state ||
+        PWRMGR_POWERSTATE_STANDBY_DEEP_SLEEP == applied_state) && powerWakeupIsEnabled(PWRMGR_WAKEUPSRC_TIMER)) {
+        /*
+         * Software standby: the kernel is not suspended, so the RTC cannot wake us.
+         * Maintenance needs the background services, not the screen; ON is the middleware's call.
+         * Escalation takes the box back down once the idle period has passed again.
+         */
+        PWRMGR_LOG_INFO("Wakeup alarm expired, resuming to standby");
+        powerEscalationCancel();
+        powerMgrRequestAutomatic(applied_state, PWRMGR_POWERSTATE_STANDBY);
+    }
+    if (powerEscalationExpire(&target)) {
+        PWRMGR_LOG_INFO("Idle in '%s', escalating to '%s'",
+                         rdkPowerStateToString(applied_state), rdkPowerStateToString(target));
+        powerMgrRequestAutomatic(applied_state, target);
+    }
+}
+
 /**
  * @brief A single shot worker thread to handle the power state changes.
  * RPi does not have proper PowerManager implementation.
+ * Besides state changes the worker also applies and expires the workload hints,
+ * writes the aggregated QoS constraints and fires the wakeup alarms.
  * Some references:
  * https://learn.pi-supply.com/make/how-to-save-power-on-your-raspberry-pi/
  * https://forums.raspberrypi.com/viewtopic.php?t=257144
@@ -166,73 +468,163 @@ char * rdkPowerStateToString(PWRMgr_PowerState_t state)
  */
 static void *powerMgrWorkerThread(void *arg)
 {
+    PWRMgr_PowerState_t applied_state = PWRMGR_POWERSTATE_ON;
+    uint64_t armed_deadline = 0;
+
+    if (powerShadowRestoredState(&applied_state)) {
+        /* Restarted: bring the knobs in line with the state the previous instance left applied. */
+        PWRMGR_LOG_INFO("Reconciling '%s'", rdkPowerStateToString(applied_state));
+        powerMgrRunActions(applied_state, applied_state);
+        powerHintApply(applied_state, true);
+        powerQosApply();
+        powerShadowCommit();
+        powerEscalationArm(applied_state);
+    }
+
     while (1) {
-        if (sem_wait(&power_state_semaphore) == -1) {
-            perror("powerMgrWorkerThread: Failed to wait on semaphore");
+        uint64_t deadline = powerMgrNextDeadline();
+        if (deadline != armed_deadline) {
+            powerMgrArmTimer(deadline);
+            armed_deadline = deadline;
+        }
+        if (!powerMgrWaitForEvents(applied_state)) {
             break;
         }
 
         if (pthread_mutex_lock(&power_state_mutex) != 0) {
-            perror("powerMgrWorkerThread: Failed to lock mutex");
+            PWRMGR_LOG_ERRNO("Failed to lock mutex");
             continue;
         }
 
         if (!thread_running) {
             if (pthread_mutex_unlock(&power_state_mutex) != 0) {
-                perror("powerMgrWorkerThread: Failed to unlock mutex");
+                PWRMGR_LOG_ERRNO("Failed to unlock mutex");
             }
             break;
         }
 
         PWRMgr_PowerState_t received_state = power_state;
+        bool state_changed = power_state_pending;
+        bool automatic = power_state_automatic;
+        power_state_pending = false;
         if (pthread_mutex_unlock(&power_state_mutex) != 0) {
-            perror("powerMgrWorkerThread: Failed to unlock mutex");
+            PWRMGR_LOG_ERRNO("Failed to unlock mutex");
         }
 
-        printf("powerMgrWorkerThread: Power state change to '[%u] %s'.\n",
-                received_state, rdkPowerStateToString(received_state));
+        if (!state_changed) {
+            /* Woken up for a deadline, a hint, QoS or alarm update only. */
+            powerMgrService(applied_state);
+            continue;
+        }
 
+        PWRMGR_LOG_INFO("Power state change to '[%u] %s'.",
+                         received_state, rdkPowerStateToString(received_state));
+
+        PWRMgr_JournalKind_t kind = automatic ? PWRMGR_JOURNAL_AUTOMATIC : PWRMGR_JOURNAL_TRANSITION;
+        uint64_t transition_start = monotonicTimeUs();
+        bool transition_done = false;
+        bool journaled = false;
         switch (received_state) {
             case PWRMGR_POWERSTATE_OFF:
-                printf("powerMgrWorkerThread: Powering off\n");
-                sync();
+                PWRMGR_LOG_INFO("Powering off");
+                /* Eager writeback gets the flushers going ahead of the remount. */
+                powerWritebackApply(applied_state, received_state);
+                powerLogFlush();
+                transition_done = powerShutdownPrepare();
+                if (!transition_done) {
+                    PWRMGR_LOG_ERROR("Not every mount was flushed, powering off anyway");
+                }
+                /* The journal's writable mapping keeps its own mount from going read-only. */
+                powerJournalAppend(kind, applied_state, received_state, transition_done,
+                        (uint32_t)(monotonicTimeUs() - transition_start), true);
+                journaled = true;
+                powerLogFlush();
                 if (reboot(RB_POWER_OFF) != 0) {
-                    perror("powerMgrWorkerThread: Failed to power off");
+                    PWRMGR_LOG_ERRNO("Failed to power off");
+                    powerShutdownAbort();
+                    transition_done = false;
+                    powerJournalAppend(kind, applied_state, received_state, false,
+                            (uint32_t)(monotonicTimeUs() - transition_start), true);
                 }
                 break;
             case PWRMGR_POWERSTATE_STANDBY:
-                printf("powerMgrWorkerThread: Powering to standby\n");
-                if (!setCPUFreqScalingGovernor("conservative")) {
-                    perror("powerMgrWorkerThread: Failed to set CPU frequency scaling governor to 'conservative'");
-                }
+                PWRMGR_LOG_INFO("Powering to standby");
+                transition_done = powerMgrRunActions(applied_state, received_state);
                 break;
             case PWRMGR_POWERSTATE_ON:
-                printf("powerMgrWorkerThread: Powering on\n");
-                if (!setCPUFreqScalingGovernor("performance")) {
-                    perror("powerMgrWorkerThread: Failed to set CPU frequency scaling governor to 'performance'");
+                PWRMGR_LOG_INFO("Powering on");
+                transition_done = powerMgrRunActions(applied_state, received_state);
+                if (!automatic) {
+                    /* Only the wakes the middleware asks for are habits. */
+                    powerPrewakeRecordWake(applied_state);
                 }
                 break;
             case PWRMGR_POWERSTATE_STANDBY_LIGHT_SLEEP:
-                printf("powerMgrWorkerThread: Powering to standby light sleep\n");
-                if (!setCPUFreqScalingGovernor("ondemand")) {
-                    perror("powerMgrWorkerThread: Failed to set CPU frequency scaling governor to 'ondemand'");
-                }
+                PWRMGR_LOG_INFO("Powering to standby light sleep");
+                transition_done = powerMgrRunActions(applied_state, received_state);
                 break;
             case PWRMGR_POWERSTATE_STANDBY_DEEP_SLEEP:
-                printf("powerMgrWorkerThread: Powering to standby deep sleep\n");
-                if (!setCPUFreqScalingGovernor("schedutil")) {
-                    perror("powerMgrWorkerThread: Failed to set CPU frequency scaling governor to 'conservative'");
+                PWRMGR_LOG_INFO("Powering to standby deep sleep");
+                transition_done = powerMgrRunActions(applied_state, received_state);
+                if (powerSuspendIsEnabled()) {
+                    /* Suspend time is not transition latency. */
+                    powerJournalAppend(kind, applied_state, received_state, transition_done,
+                            (uint32_t)(monotonicTimeUs() - transition_start), false);
+                    journaled = true;
+                    sync();
+                    powerSuspendToIdle();
                 }
                 break;
             default:
-                printf("powerMgrWorkerThread: Invalid power state\n");
+                PWRMGR_LOG_ERROR("Invalid power state");
                 break;
         }
-        sync();
+        if (!journaled) {
+            powerJournalAppend(kind, applied_state, received_state, transition_done,
+                    (uint32_t)(monotonicTimeUs() - transition_start), false);
+        }
+        applied_state = received_state;
+        /* Hotplugged devices may have added baselines during the transition. */
+        powerShadowCommit();
+        powerShadowStoreState(applied_state);
+        powerPrewakeService(applied_state);
+        powerHintApply(applied_state, true);
+        powerQosApply();
+        powerSuspendResumeComplete();
+        powerEscalationArm(applied_state);
     }
     return NULL;
 }
 
+/**
+ * @brief Restore every module's baselines and release what it holds.
+ * Used by PLAT_TERM() and by a PLAT_INIT() that fails once the modules are
+ * initialized, so a retry snapshots untouched knobs. The worker thread must
+ * not be running.
+*/
+static void powerMgrTermModules(void)
+{
+    powerPrewakeTerm();
+    powerPrefetchTerm();
+    powerHintTerm();
+    powerQosTerm();
+    powerRfkillTerm();
+    powerDisplayTerm();
+    powerPciTerm();
+    powerUsbTerm();
+    powerAffinityTerm();
+    powerCpuHotplugTerm();
+    powerCpuidleTerm();
+    powerCgroupTerm();
+    powerWritebackTerm();
+    powerFreezerTerm();
+    powerAlarmTerm();
+    powerKexecTerm();
+    powerJournalTerm();
+    powerShadowTerm();
+    powerLogTerm();
+}
+
 /**
  * @brief Initializes the underlying Power Management module
  * This function must initialize all aspects of the CPE's Power Management module.
@@ -243,43 +635,116 @@ static void *powerMgrWorkerThread(void *arg)
  */
 pmStatus_t PLAT_INIT(void)
 {
-    fprintf(stderr, "PLAT_INIT: PowerMgr HAL version: %s\n", PWRHALVERSION);
+    PWRMGR_LOG_INFO("PowerMgr HAL version: %s", PWRHALVERSION);
 
-    if (access(CPU_FREQ_SCALING_GOVERNOR_PATH, F_OK | R_OK | W_OK) != 0) {
-        perror("PLAT_INIT: Failed to access CPU frequency scaling governor file");
+    char governor_path[PWRMGR_PATH_MAX];
+    if (!sysfsResolvePath(CPU_FREQ_SCALING_GOVERNOR_PATH, governor_path, sizeof(governor_path)) ||
+        access(governor_path, F_OK | R_OK | W_OK) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to access CPU frequency scaling governor file");
         return PWRMGR_INIT_FAILURE;
     }
     if (PWRMGR_NOT_INITIALIZED == powerMgrStatus) {
+        powerLogInit();
         if (pthread_mutex_lock(&power_state_mutex) != 0) {
-            perror("PLAT_INIT: Failed to lock mutex");
+            PWRMGR_LOG_ERRNO("Failed to lock mutex");
+            powerLogTerm();
             return PWRMGR_INIT_FAILURE;
         }
-        power_state = PWRMGR_POWERSTATE_ON;
+        /* A restart picks up the state the previous instance left applied. */
+        PWRMgr_PowerState_t restored_state;
+        powerShadowInit();
+        powerShadowRestoredState(&restored_state);
+        power_state = restored_state;
+        power_state_pending = false;
+        power_state_automatic = false;
         if (pthread_mutex_unlock(&power_state_mutex) != 0) {
-            perror("PLAT_INIT: Failed to unlock mutex");
+            PWRMGR_LOG_ERRNO("Failed to unlock mutex");
+            powerLogTerm();
             return PWRMGR_INIT_FAILURE;
         }
 
-        if (sem_init(&power_state_semaphore, 0, 0) != 0) {
-            perror("PLAT_INIT: Failed to initialize semaphore");
+        powerJournalInit();
+        powerJournalAppend(PWRMGR_JOURNAL_INIT, PWRMGR_POWERSTATE_MAX, restored_state, true, 0, false);
+        powerHintInit();
+        powerQosInit();
+        powerCpuHotplugInit();
+        powerCpuidleInit();
+        powerCgroupInit();
+        powerFreezerInit();
+        powerMemoryInit();
+        powerWritebackInit();
+        powerAffinityInit();
+        powerUsbInit();
+        powerPciInit();
+        powerDisplayInit();
+        powerRfkillInit();
+        powerPrefetchInit();
+        powerPrewakeInit();
+        powerWakeupInit();
+        powerAlarmInit();
+        powerEscalationInit();
+        powerSuspendInit();
+        powerKexecInit();
+        powerShadowCommit();
+
+        powerUeventInit();
+        if (!powerMgrEventLoopInit()) {
+            powerUeventTerm();
+            powerMgrTermModules();
             return PWRMGR_INIT_FAILURE;
         }
         thread_running = 1;
 
-        if (pthread_create(&worker_thread, NULL, powerMgrWorkerThread, NULL) != 0) {
-            perror("PLAT_INIT: Failed to create worker thread");
-            sem_destroy(&power_state_semaphore);
-            return PWRMGR_OPERATION_NOT_SUPPORTED;
+        pthread_attr_t attr;
+        bool created = pthread_attr_init(&attr) == 0;
+        if (created) {
+            /* Falls back to the default stack if the size is below the minimum. */
+            pthread_attr_setstacksize(&attr, WORKER_STACK_SIZE);
+            created = pthread_create(&worker_thread, &attr, powerMgrWorkerThread, NULL) == 0;
+            pthread_attr_destroy(&attr);
+        }
+        if (!created) {
+            PWRMGR_LOG_ERRNO("Failed to create worker thread");
+            powerMgrEventLoopTerm();
+            powerUeventTerm();
+            powerMgrTermModules();
+            return PWRMGR_INIT_FAILURE;
         }
 
         powerMgrStatus = PWRMGR_ALREADY_INITIALIZED;
-        printf("PLAT_INIT: HAL init success.\n");
+        PWRMGR_LOG_INFO("HAL init success.");
         return PWRMGR_SUCCESS;
     }
 
     return PWRMGR_ALREADY_INITIALIZED;
 }
 
+/**
+ * @brief Queue a power state change for the worker thread.
+ * Used by PLAT_API_SetPowerState() and by HAL internal wake events.
+ * @param newState The new power state, must be valid.
+ * @return PWRMGR_SUCCESS or PWRMGR_SET_FAILURE.
+*/
+pmStatus_t powerMgrRequestState(PWRMgr_PowerState_t newState)
+{
+    if (pthread_mutex_lock(&power_state_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_SET_FAILURE;
+    }
+    power_state = newState;
+    power_state_pending = true;
+    power_state_automatic = false;
+    if (pthread_mutex_unlock(&power_state_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to unlock mutex");
+        return PWRMGR_SET_FAILURE;
+    }
+
+    if (!powerMgrWakeWorker()) {
+        return PWRMGR_SET_FAILURE;
+    }
+    return PWRMGR_SUCCESS;
+}
+
 /**
  * @brief Sets the CPE Power State
  * This fumction is just required to hold the value of the current power state status.
@@ -299,21 +764,8 @@ pmStatus_t PLAT_API_SetPowerState(PWRMgr_PowerState_t newState)
         return PWRMGR_NOT_INITIALIZED;
     }
     if (newState >= PWRMGR_POWERSTATE_OFF && newState < PWRMGR_POWERSTATE_MAX) {
-        if (pthread_mutex_lock(&power_state_mutex) != 0) {
-            perror("PLAT_API_SetPowerState: Failed to lock mutex");
-            return PWRMGR_SET_FAILURE;
-        }
-        power_state = newState;
-        if (pthread_mutex_unlock(&power_state_mutex) != 0) {
-            perror("PLAT_API_SetPowerState: Failed to unlock mutex");
-            return PWRMGR_SET_FAILURE;
-        }
-
-        if (sem_post(&power_state_semaphore) != 0) {
-            perror("PLAT_API_SetPowerState: Failed to post semaphore");
-            return PWRMGR_SET_FAILURE;
-        }
-        return PWRMGR_SUCCESS;
+        powerEscalationCancel();
+        return powerMgrRequestState(newState);
     }
 
     return PWRMGR_INVALID_ARGUMENT;
@@ -342,14 +794,14 @@ pmStatus_t PLAT_API_GetPowerState(PWRMgr_PowerState_t *curState)
     }
 
     if (pthread_mutex_lock(&power_state_mutex) != 0) {
-        perror("PLAT_API_GetPowerState: Failed to lock mutex");
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
         return PWRMGR_GET_FAILURE;
     }
 
     *curState = power_state;
 
     if (pthread_mutex_unlock(&power_state_mutex) != 0) {
-        perror("PLAT_API_GetPowerState: Failed to unlock mutex");
+        PWRMGR_LOG_ERRNO("Failed to unlock mutex");
         return PWRMGR_GET_FAILURE;
     }
 
@@ -382,8 +834,7 @@ pmStatus_t PLAT_API_SetWakeupSrc(PWRMGR_WakeupSrcType_t srcType, bool enable)
     if (!(srcType >= PWRMGR_WAKEUPSRC_VOICE && srcType < PWRMGR_WAKEUPSRC_MAX)) {
         return PWRMGR_INVALID_ARGUMENT;
     }
-    /* FIXME: RPi don't have WakeUp Source configurations at the moment. */
-    return PWRMGR_OPERATION_NOT_SUPPORTED;
+    return powerWakeupSet(srcType, enable);
 }
 
 /**
@@ -414,8 +865,11 @@ pmStatus_t PLAT_API_GetWakeupSrc(PWRMGR_WakeupSrcType_t srcType, bool  *enable)
     if (!(srcType >= PWRMGR_WAKEUPSRC_VOICE && srcType < PWRMGR_WAKEUPSRC_MAX) || NULL == enable) {
         return PWRMGR_INVALID_ARGUMENT;
     }
-    /* FIXME: RPi don't have WakeUp Source configurations at the moment. */
-    return PWRMGR_OPERATION_NOT_SUPPORTED;
+    if (!powerWakeupIsSupported(srcType)) {
+        return PWRMGR_OPERATION_NOT_SUPPORTED;
+    }
+    *enable = powerWakeupIsEnabled(srcType);
+    return PWRMGR_SUCCESS;
 }
 
 #ifdef ENABLE_THERMAL_PROTECTION
@@ -455,18 +909,18 @@ int PLAT_API_GetTemperature(mfrTemperatureState_t *curState, float *curTemperatu
     IARM_Bus_PWRMgr_ThermalState_t state = mfrTEMPERATURE_NORMAL;
 
     if (access(THERMAL_ZONE_TEMPERATURE_PATH, F_OK | R_OK) != 0) {
-        perror("PLAT_API_GetTemperature: Failed to access thermal zone0 temp file");
+        PWRMGR_LOG_ERRNO("Failed to access thermal zone0 temp file");
         return mfrERR_TEMP_READ_FAILED;
     }
 
     FILE* fp = fopen(THERMAL_ZONE_TEMPERATURE_PATH, "r");
     if (fp == NULL) {
-        perror("PLAT_API_GetTemperature: Failed to open thermal zone0 temp file");
+        PWRMGR_LOG_ERRNO("Failed to open thermal zone0 temp file");
         return mfrERR_TEMP_READ_FAILED;
     }
 
     if (fscanf(fp, "%d", &value) != 1) {
-        perror("PLAT_API_GetTemperature: Failed to read thermal zone0 temp file");
+        PWRMGR_LOG_ERRNO("Failed to read thermal zone0 temp file");
         fclose(fp);
         return mfrERR_TEMP_READ_FAILED;
     }
@@ -497,12 +951,12 @@ int PLAT_API_GetTemperature(mfrTemperatureState_t *curState, float *curTemperatu
 int PLAT_API_SetTempThresholds(float tempHigh, float tempCritical)
 {
     if (tempHigh < 0 || tempCritical < 0) {
-        printf("PLAT_API_SetTempThresholds: Temperature thresholds must be non-negative\n");
+        PWRMGR_LOG_ERROR("Temperature thresholds must be non-negative");
         return mfrERR_INVALID_PARAM;
     }
 
     if (tempCritical < tempHigh) {
-        printf("PLAT_API_SetTempThresholds: Critical temperature threshold must be greater than or equal to high temperature threshold\n");
+        PWRMGR_LOG_ERROR("Critical temperature threshold must be greater than or equal to high temperature threshold");
         return mfrERR_INVALID_PARAM;
     }
 
@@ -556,19 +1010,19 @@ int PLAT_API_DetemineClockSpeeds(uint32_t *cpu_rate_Normal, uint32_t *cpu_rate_S
     *cpu_rate_Minimal = MINIMAL_CLOCK_SPEED;
 
     if (access(CPU_FREQ_SCALING_CUR_FREQ_PATH, F_OK | R_OK) != 0) {
-        perror("Failed to access CPU frequency scaling current frequency file");
+        PWRMGR_LOG_ERRNO("Failed to access CPU frequency scaling current frequency file");
         return mfrERR_FLASH_READ_FAILED;
     }
 
     FILE *fp = fopen(CPU_FREQ_SCALING_CUR_FREQ_PATH, "r");
     if (fp == NULL) {
-        perror("Failed to open CPU frequency scaling current frequency file");
+        PWRMGR_LOG_ERRNO("Failed to open CPU frequency scaling current frequency file");
         return mfrERR_FLASH_READ_FAILED;
     }
 
     int value = 0;
     if (fscanf(fp, "%d", &value) != 1) {
-        perror("Failed to read CPU frequency scaling current frequency file");
+        PWRMGR_LOG_ERRNO("Failed to read CPU frequency scaling current frequency file");
         fclose(fp);
         return mfrERR_FLASH_READ_FAILED;
     }
@@ -576,10 +1030,10 @@ int PLAT_API_DetemineClockSpeeds(uint32_t *cpu_rate_Normal, uint32_t *cpu_rate_S
 
     // Value read is in kHz, convert it to MHz
     uint32_t current_speed = value / 1000;
-    printf("Current CPU clock speed: %u MHz\n", current_speed);
+    PWRMGR_LOG_DEBUG("Current CPU clock speed: %u MHz", current_speed);
     return mfrERR_NONE;
 #else
-    printf("PLAT_API_DetemineClockSpeeds: Not implemented\n");
+    PWRMGR_LOG_WARN("Not implemented");
     return mfrERR_OPERATION_NOT_SUPPORTED;
 #endif
 }
@@ -596,48 +1050,48 @@ int PLAT_API_SetClockSpeed(uint32_t speed)
 #if 0 /* Enable when proper HAL Spec is available. */
     uint32_t speed_khz = speed * 1000;
     if (access(CPU_FREQ_SCALING_SETSPEED_PATH, F_OK | W_OK) != 0) {
-        perror("Failed to access CPU frequency scaling set speed file");
+        PWRMGR_LOG_ERRNO("Failed to access CPU frequency scaling set speed file");
         return mfrERR_FLASH_READ_FAILED;
     }
     // Check if the scaling_setspeed file is supported
     FILE *fp = fopen(CPU_FREQ_SCALING_SETSPEED_PATH, "r");
     if (fp == NULL) {
-        perror("Failed to open CPU frequency scaling set speed file for reading");
+        PWRMGR_LOG_ERRNO("Failed to open CPU frequency scaling set speed file for reading");
         return mfrERR_FLASH_READ_FAILED;
     }
 
     char buffer[32] = {0};
     if (fgets(buffer, sizeof(buffer), fp) == NULL) {
-        perror("Failed to read CPU frequency scaling set speed file");
+        PWRMGR_LOG_ERRNO("Failed to read CPU frequency scaling set speed file");
         fclose(fp);
         return mfrERR_FLASH_READ_FAILED;
     }
     fclose(fp);
 
     if (strncmp(buffer, "<unsupported>", 13) == 0) {
-        fprintf(stderr, "CPU frequency scaling set speed is unsupported\n");
+        PWRMGR_LOG_ERROR("CPU frequency scaling set speed is unsupported");
         return mfrERR_OPERATION_NOT_SUPPORTED;
     }
 
     fp = fopen(CPU_FREQ_SCALING_SETSPEED_PATH, "w");
     if (fp == NULL) {
-        perror("Failed to open CPU frequency scaling set speed file for writing");
+        PWRMGR_LOG_ERRNO("Failed to open CPU frequency scaling set speed file for writing");
         return mfrERR_WRITE_FLASH_FAILED;
     }
 
     if (fprintf(fp, "%u", speed_khz) < 0) {
-        perror("Failed to write CPU frequency scaling set speed file");
+        PWRMGR_LOG_ERRNO("Failed to write CPU frequency scaling set speed file");
         fclose(fp);
         return mfrERR_WRITE_FLASH_FAILED;
     }
 
     if (fclose(fp) != 0) {
-        perror("Failed to close CPU frequency scaling set speed file");
+        PWRMGR_LOG_ERRNO("Failed to close CPU frequency scaling set speed file");
         return mfrERR_WRITE_FLASH_FAILED;
     }
     return mfrERR_NONE;
 #else
-    printf("PLAT_API_SetClockSpeed: Not implemented\n");
+    PWRMGR_LOG_WARN("Not implemented");
     return mfrERR_OPERATION_NOT_SUPPORTED;
 #endif
 }
@@ -655,18 +1109,18 @@ int PLAT_API_GetClockSpeed(uint32_t *speed)
     }
 #if 0 /* Enable when proper HAL Spec is available. */
     if (access(CPU_FREQ_SCALING_CUR_FREQ_PATH, F_OK | R_OK) != 0) {
-        perror("Failed to access CPU frequency scaling current frequency file");
+        PWRMGR_LOG_ERRNO("Failed to access CPU frequency scaling current frequency file");
         return mfrERR_FLASH_READ_FAILED;
     }
     FILE *fp = fopen(CPU_FREQ_SCALING_CUR_FREQ_PATH, "r");
     if (fp == NULL) {
-        perror("Failed to open CPU frequency scaling current frequency file");
+        PWRMGR_LOG_ERRNO("Failed to open CPU frequency scaling current frequency file");
         return mfrERR_FLASH_READ_FAILED;
     }
 
     int value = 0;
     if (fscanf(fp, "%d", &value) != 1) {
-        perror("Failed to read CPU frequency scaling current frequency file");
+        PWRMGR_LOG_ERRNO("Failed to read CPU frequency scaling current frequency file");
         fclose(fp);
         return mfrERR_FLASH_READ_FAILED;
     }
@@ -676,7 +1130,7 @@ int PLAT_API_GetClockSpeed(uint32_t *speed)
     *speed = value / 1000;
     return mfrERR_NONE;
 #else
-    printf("PLAT_API_GetClockSpeed: Not implemented\n");
+    PWRMGR_LOG_WARN("Not implemented");
     return mfrERR_OPERATION_NOT_SUPPORTED;
 #endif
 }
@@ -704,26 +1158,28 @@ pmStatus_t PLAT_TERM(void)
     }
 
     if (pthread_mutex_lock(&power_state_mutex) != 0) {
-        perror("PLAT_TERM: Failed to lock mutex");
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
         return PWRMGR_TERM_FAILURE;
     }
 
     thread_running = 0;
 
     if (pthread_mutex_unlock(&power_state_mutex) != 0) {
-        perror("PLAT_TERM: Failed to unlock mutex");
+        PWRMGR_LOG_ERRNO("Failed to unlock mutex");
         return PWRMGR_TERM_FAILURE;
     }
 
-    if (sem_post(&power_state_semaphore) != 0) {
-        perror("PLAT_TERM: Failed to post semaphore");
+    if (!powerMgrWakeWorker()) {
         return PWRMGR_TERM_FAILURE;
     }
 
     if (pthread_join(worker_thread, NULL) != 0) {
-        perror("PLAT_TERM: Failed to join worker thread");
+        PWRMGR_LOG_ERRNO("Failed to join worker thread");
         return PWRMGR_TERM_FAILURE;
     }
+    powerMgrEventLoopTerm();
+    powerUeventTerm();
+    powerMgrTermModules();
 
     powerMgrStatus = PWRMGR_NOT_INITIALIZED;
     return PWRMGR_SUCCESS;
@@ -760,35 +1216,48 @@ pmStatus_t PLAT_Reset(PWRMgr_PowerState_t newState)
     }
 
     if (pthread_mutex_lock(&power_state_mutex) != 0) {
-        perror("PLAT_Reset: Failed to lock mutex");
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
         return PWRMGR_SET_FAILURE;
     }
 
     thread_running = 0;
 
     if (pthread_mutex_unlock(&power_state_mutex) != 0) {
-        perror("PLAT_Reset: Failed to unlock mutex");
+        PWRMGR_LOG_ERRNO("Failed to unlock mutex");
         return PWRMGR_SET_FAILURE;
     }
 
-    if (sem_post(&power_state_semaphore) != 0) {
-        perror("PLAT_Reset: Failed to post semaphore");
+    if (!powerMgrWakeWorker()) {
         return PWRMGR_SET_FAILURE;
     }
 
     if (pthread_join(worker_thread, NULL) != 0) {
-        perror("PLAT_Reset: Failed to join worker thread");
+        PWRMGR_LOG_ERRNO("Failed to join worker thread");
         return PWRMGR_SET_FAILURE;
     }
 
+    powerLogFlush();
+    bool prepared = powerShutdownPrepare();
+    if (!prepared) {
+        PWRMGR_LOG_ERROR("Not every mount was flushed, resetting anyway");
+    }
+    /* The journal's writable mapping keeps its own mount from going read-only. */
+    powerJournalAppend(PWRMGR_JOURNAL_RESET, power_state, newState, prepared, 0, true);
+    powerLogFlush();
     if (newState == PWRMGR_POWERSTATE_OFF) {
         if (reboot(RB_POWER_OFF) != 0) {
-            perror("PLAT_Reset: Failed to power off");
+            PWRMGR_LOG_ERRNO("Failed to power off");
+            powerShutdownAbort();
+            powerJournalAppend(PWRMGR_JOURNAL_RESET, power_state, newState, false, 0, true);
             return PWRMGR_SET_FAILURE;
         }
     } else {
+        /* Returns only if kexec is disabled or could not be started. */
+        powerKexecReboot();
         if (reboot(RB_AUTOBOOT) != 0) {
-            perror("PLAT_Reset: Failed to reboot");
+            PWRMGR_LOG_ERRNO("Failed to reboot");
+            powerShutdownAbort();
+            powerJournalAppend(PWRMGR_JOURNAL_RESET, power_state, newState, false, 0, true);
             return PWRMGR_SET_FAILURE;
         }
     }
@@ -0,0 +1,336 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Page cache prefetch. When the box leaves ON, mincore(2) records which
+ * pages of the files in powerPrefetchFiles[] are resident, merged into
+ * ranges. When it returns to ON, a background thread at the highest
+ * best-effort I/O priority reads those ranges back in, so the UI does not
+ * pay for the page cache reclaimed during standby.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "plat-power-priv.h"
+
+#define PREFETCH_MAX_FILES      64
+#define PREFETCH_MAX_RANGES     4096
+#define PREFETCH_MAX_FILE_SIZE  (256L * 1024 * 1024)
+
+/* From linux/ioprio.h, which is not exported to user space everywhere. */
+#define IOPRIO_CLASS_SHIFT      13
+#define IOPRIO_CLASS_BE         2
+#define IOPRIO_WHO_PROCESS      1
+
+typedef struct {
+    uint16_t file;              ///< Index into prefetch_files
+    uint32_t firstPage;
+    uint32_t pageCount;
+} PrefetchRange_t;
+
+/* Written by the worker only while no prefetch thread runs. */
+static char prefetch_files[PREFETCH_MAX_FILES][PWRMGR_PATH_MAX];
+static int prefetch_file_count = 0;
+static PrefetchRange_t prefetch_ranges[PREFETCH_MAX_RANGES];
+static int prefetch_range_count = 0;
+static long prefetch_page_size = 4096;
+
+static pthread_t prefetch_thread;
+static bool prefetch_thread_started = false;
+static atomic_bool prefetch_stop = false;
+
+static pthread_mutex_t prefetch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool prefetch_enabled = true;
+static PWRMgr_PrefetchStats_t prefetch_stats;
+static uint64_t prefetch_on_ms = 0;        ///< ON applied, 0 once the first frame was counted
+static bool prefetch_on_prefetched = false;
+
+/**
+ * @brief Record the resident ranges of one file.
+*/
+static void prefetchSnapshotFile(const char *path, void *context)
+{
+    uint64_t *residentBytes = context;
+    char resolved[PWRMGR_PATH_MAX];
+    struct stat st;
+    if (prefetch_file_count == PREFETCH_MAX_FILES || strlen(path) >= PWRMGR_PATH_MAX ||
+        !sysfsResolvePath(path, resolved, sizeof(resolved))) {
+        return;
+    }
+    int fd = open(resolved, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return;
+    }
+    size_t length = (size_t)((st.st_size > PREFETCH_MAX_FILE_SIZE) ? PREFETCH_MAX_FILE_SIZE : st.st_size);
+    size_t pages = (length + (size_t)prefetch_page_size - 1) / (size_t)prefetch_page_size;
+    void *map = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == map) {
+        PWRMGR_LOG_ERRNO("Failed to map file");
+        return;
+    }
+    unsigned char *resident = malloc(pages);
+    if (NULL == resident || mincore(map, length, resident) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to query residency");
+        free(resident);
+        munmap(map, length);
+        return;
+    }
+    int file = prefetch_file_count++;
+    snprintf(prefetch_files[file], sizeof(prefetch_files[file]), "%s", path);
+    for (size_t page = 0; page < pages && prefetch_range_count < PREFETCH_MAX_RANGES;) {
+        if (!(resident[page] & 1)) {
+            page++;
+            continue;
+        }
+        size_t first = page;
+        while (page < pages && (resident[page] & 1)) {
+            page++;
+        }
+        PrefetchRange_t *range = &prefetch_ranges[prefetch_range_count++];
+        range->file = (uint16_t)file;
+        range->firstPage = (uint32_t)first;
+        range->pageCount = (uint32_t)(page - first);
+        *residentBytes += (uint64_t)(page - first) * (uint64_t)prefetch_page_size;
+    }
+    free(resident);
+    munmap(map, length);
+}
+
+/**
+ * @brief Replace the snapshot with the pages resident right now. Worker thread only.
+*/
+static void prefetchSnapshot(void)
+{
+    uint64_t start = monotonicTimeUs();
+    uint64_t residentBytes = 0;
+    prefetch_file_count = 0;
+    prefetch_range_count = 0;
+    for (const char *const *pattern = powerPrefetchFiles; NULL != *pattern; pattern++) {
+        sysfsGlob(*pattern, prefetchSnapshotFile, &residentBytes);
+    }
+    uint32_t elapsed = (uint32_t)(monotonicTimeUs() - start);
+    pthread_mutex_lock(&prefetch_mutex);
+    prefetch_stats.fileCount = (uint32_t)prefetch_file_count;
+    prefetch_stats.rangeCount = (uint32_t)prefetch_range_count;
+    prefetch_stats.snapshotBytes = residentBytes;
+    prefetch_stats.lastSnapshotUs = elapsed;
+    pthread_mutex_unlock(&prefetch_mutex);
+    PWRMGR_LOG_INFO("%d ranges, %llu bytes resident in %d files, %u us", prefetch_range_count,
+                     (unsigned long long)residentBytes, prefetch_file_count, elapsed);
+}
+
+static void *prefetchThread(void *arg)
+{
+    (void)arg;
+    uint64_t start = monotonicTimeUs();
+    uint64_t bytes = 0;
+    int fd = -1;
+    int openFile = -1;
+
+    /* Level 0 is the highest best-effort priority; the RT class needs CAP_SYS_ADMIN. */
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, (IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT) | 0) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to raise I/O priority");
+    }
+    for (int i = 0; i < prefetch_range_count && !atomic_load(&prefetch_stop); i++) {
+        const PrefetchRange_t *range = &prefetch_ranges[i];
+        if (range->file != openFile) {
+            char resolved[PWRMGR_PATH_MAX];
+            if (fd >= 0) {
+                close(fd);
+            }
+            openFile = range->file;
+            fd = sysfsResolvePath(prefetch_files[openFile], resolved, sizeof(resolved)) ?
+                 open(resolved, O_RDONLY | O_CLOEXEC) : -1;
+        }
+        if (fd < 0) {
+            continue;
+        }
+        off_t offset = (off_t)range->firstPage * prefetch_page_size;
+        off_t length = (off_t)range->pageCount * prefetch_page_size;
+        /* Issues the reads from this thread, so they carry its I/O priority. */
+        if (posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED) == 0) {
+            bytes += (uint64_t)length;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    uint32_t elapsed = (uint32_t)(monotonicTimeUs() - start);
+    pthread_mutex_lock(&prefetch_mutex);
+    prefetch_stats.lastPrefetchBytes = bytes;
+    prefetch_stats.lastPrefetchUs = elapsed;
+    pthread_mutex_unlock(&prefetch_mutex);
+    PWRMGR_LOG_INFO("Prefetched %llu bytes in %u us", (unsigned long long)bytes, elapsed);
+    return NULL;
+}
+
+static void prefetchJoin(void)
+{
+    if (prefetch_thread_started) {
+        atomic_store(&prefetch_stop, true);
+        pthread_join(prefetch_thread, NULL);
+        prefetch_thread_started = false;
+    }
+}
+
+/**
+ * @brief Read the last snapshot back in, in the background. Worker thread only.
+ * Does nothing if the prefetch is disabled or no snapshot was taken yet.
+*/
+void powerPrefetchStart(void)
+{
+    pthread_mutex_lock(&prefetch_mutex);
+    bool enabled = prefetch_enabled;
+    pthread_mutex_unlock(&prefetch_mutex);
+    prefetchJoin();
+    if (!enabled || 0 == prefetch_range_count) {
+        return;
+    }
+    atomic_store(&prefetch_stop, false);
+    if (pthread_create(&prefetch_thread, NULL, prefetchThread, NULL) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to create prefetch thread");
+        return;
+    }
+    prefetch_thread_started = true;
+}
+
+/**
+ * @brief Reset the snapshot and the statistics.
+ * Must be called before the worker thread is started.
+*/
+void powerPrefetchInit(void)
+{
+    long pageSize = sysconf(_SC_PAGESIZE);
+    prefetch_page_size = (pageSize > 0) ? pageSize : 4096;
+    prefetch_file_count = 0;
+    prefetch_range_count = 0;
+    pthread_mutex_lock(&prefetch_mutex);
+    prefetch_enabled = true;
+    prefetch_on_ms = 0;
+    memset(&prefetch_stats, 0, sizeof(prefetch_stats));
+    pthread_mutex_unlock(&prefetch_mutex);
+}
+
+/**
+ * @brief Stop a running prefetch.
+ * Must be called after the worker thread has been joined.
+*/
+void powerPrefetchTerm(void)
+{
+    prefetchJoin();
+}
+
+/**
+ * @brief Worker action: snapshot on leaving ON, prefetch on returning to it.
+ * @param from The state being left.
+ * @param to The state being entered.
+ * @return true.
+*/
+bool powerPrefetchApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to)
+{
+    if (PWRMGR_POWERSTATE_ON == from && PWRMGR_POWERSTATE_ON != to) {
+        prefetchJoin();
+        prefetchSnapshot();
+    } else if (PWRMGR_POWERSTATE_ON == to && PWRMGR_POWERSTATE_ON != from) {
+        powerPrefetchStart();
+        pthread_mutex_lock(&prefetch_mutex);
+        prefetch_on_ms = monotonicTimeMs();
+        prefetch_on_prefetched = prefetch_thread_started;
+        pthread_mutex_unlock(&prefetch_mutex);
+    }
+    return true;
+}
+
+/**
+ * @brief Enables or disables the page cache prefetch on resume.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_SetPagecachePrefetch(bool enable)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (pthread_mutex_lock(&prefetch_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_SET_FAILURE;
+    }
+    prefetch_enabled = enable;
+    pthread_mutex_unlock(&prefetch_mutex);
+    return PWRMGR_SUCCESS;
+}
+
+/**
+ * @brief Reports that the UI has rendered its first frame after a resume.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_ReportFirstFrame(void)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (pthread_mutex_lock(&prefetch_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_SET_FAILURE;
+    }
+    if (0 != prefetch_on_ms) {
+        uint32_t elapsed = (uint32_t)(monotonicTimeMs() - prefetch_on_ms);
+        uint32_t *count = prefetch_on_prefetched ? &prefetch_stats.prefetchedResumes : &prefetch_stats.coldResumes;
+        uint32_t *average = prefetch_on_prefetched ? &prefetch_stats.avgFirstFrameMsPrefetched : &prefetch_stats.avgFirstFrameMsCold;
+        (*count)++;
+        *average = (uint32_t)(((uint64_t)*average * (*count - 1) + elapsed) / *count);
+        prefetch_stats.lastFirstFrameMs = elapsed;
+        prefetch_on_ms = 0;
+    }
+    pthread_mutex_unlock(&prefetch_mutex);
+    return PWRMGR_SUCCESS;
+}
+
+/**
+ * @brief Gets the page cache prefetch statistics.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_GetPrefetchStats(PWRMgr_PrefetchStats_t *stats)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (NULL == stats) {
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    if (pthread_mutex_lock(&prefetch_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_GET_FAILURE;
+    }
+    *stats = prefetch_stats;
+    pthread_mutex_unlock(&prefetch_mutex);
+    return PWRMGR_SUCCESS;
+}
@@ -0,0 +1,287 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Predictive pre-wake. Every wake from a standby state the middleware asks
+ * for is counted in an hour-of-week histogram that survives reboots; wakes
+ * the HAL makes on its own are not habits and are left out. While the box is
+ * in a standby state and an hour with enough observations approaches, the
+ * worker raises the CPU frequency floor, thaws the UI and prefetches the hot
+ * pages, so a habitual wake finds a warm box. The pre-wake ends with the hour;
+ * if the box was resumed from suspend-to-idle for it, deep sleep is re-entered.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "plat-power-priv.h"
+
+#define PREWAKE_HISTOGRAM_PATH  "/opt/persistent/pwrmgr_usage.dat"
+#define PREWAKE_MAGIC           0x50574855  /* "PWHU" */
+#define PREWAKE_VERSION         1
+#define PREWAKE_BINS            (7 * 24)
+/* Halve the histogram when a bin reaches this, so habits can change. */
+#define PREWAKE_DECAY_COUNT     32
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t bins;
+    uint16_t counts[PREWAKE_BINS];
+} PrewakeHistogram_t;
+
+/* Only touched by the worker thread, or before it is started. */
+static PrewakeHistogram_t prewake_histogram;
+static bool prewake_active = false;
+static bool prewake_resumed_deep_sleep = false;
+static PWRMgr_QosHandle_t prewake_qos = 0;
+
+static void prewakeLoad(void)
+{
+    char path[PWRMGR_PATH_MAX];
+    PrewakeHistogram_t loaded;
+    memset(&prewake_histogram, 0, sizeof(prewake_histogram));
+    prewake_histogram.magic = PREWAKE_MAGIC;
+    prewake_histogram.version = PREWAKE_VERSION;
+    prewake_histogram.bins = PREWAKE_BINS;
+    if (!sysfsResolvePath(PREWAKE_HISTOGRAM_PATH, path, sizeof(path))) {
+        return;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    ssize_t len = read(fd, &loaded, sizeof(loaded));
+    close(fd);
+    if (len == (ssize_t)sizeof(loaded) && PREWAKE_MAGIC == loaded.magic &&
+        PREWAKE_VERSION == loaded.version && PREWAKE_BINS == loaded.bins) {
+        prewake_histogram = loaded;
+    } else {
+        PWRMGR_LOG_WARN("Ignoring malformed '%s'", path);
+    }
+}
+
+/**
+ * @brief Persist the histogram; written aside and renamed so a power cut
+ * leaves either the old or the new file.
+*/
+static void prewakeStore(void)
+{
+    char path[PWRMGR_PATH_MAX];
+    char temp[PWRMGR_PATH_MAX];
+    if (!sysfsResolvePath(PREWAKE_HISTOGRAM_PATH, path, sizeof(path)) ||
+        snprintf(temp, sizeof(temp), "%s.tmp", path) >= (int)sizeof(temp)) {
+        return;
+    }
+    int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        PWRMGR_LOG_ERRNO("Failed to open usage histogram");
+        return;
+    }
+    bool written = write(fd, &prewake_histogram, sizeof(prewake_histogram)) == (ssize_t)sizeof(prewake_histogram) &&
+                   fsync(fd) == 0;
+    close(fd);
+    if (!written || rename(temp, path) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to store usage histogram");
+        unlink(temp);
+    }
+}
+
+/**
+ * @brief Get the hour-of-week bin of a wall clock time, in local time.
+ * @param hourStart Set to the start of that hour.
+*/
+static int prewakeBin(time_t when, time_t *hourStart)
+{
+    struct tm local;
+    localtime_r(&when, &local);
+    *hourStart = when - local.tm_min * 60 - local.tm_sec;
+    return local.tm_wday * 24 + local.tm_hour;
+}
+
+/**
+ * @brief Find the pre-wake window that is running or comes next.
+ * A window opens leadSec before a likely hour and closes at its end.
+ * @return true if a window exists, with its bounds in wall clock time.
+*/
+static bool prewakeNextWindow(time_t now, time_t *windowStart, time_t *windowEnd)
+{
+    time_t hourStart;
+    int bin = prewakeBin(now, &hourStart);
+    /* Look one week ahead, plus the next hour for the lead of its window. */
+    for (int offset = 0; offset <= PREWAKE_BINS; offset++) {
+        if (prewake_histogram.counts[(bin + offset) % PREWAKE_BINS] < powerPrewakePolicy.minObservations) {
+            continue;
+        }
+        time_t start = hourStart + (time_t)offset * 3600;
+        if (now >= start + 3600) {
+            continue;
+        }
+        *windowStart = start - (time_t)powerPrewakePolicy.leadSec;
+        *windowEnd = start + 3600;
+        return true;
+    }
+    return false;
+}
+
+static void prewakeStart(void)
+{
+    PWRMGR_LOG_INFO("Likely wake ahead, pre-waking");
+    prewake_active = true;
+    if (powerPrewakePolicy.minFreqPercent >= 0) {
+        long minFreq = 0;
+        long maxFreq = 0;
+        if (sysfsReadLong(CPU_FREQ_CPUINFO_MIN_FREQ_PATH, &minFreq) &&
+            sysfsReadLong(CPU_FREQ_CPUINFO_MAX_FREQ_PATH, &maxFreq)) {
+            int32_t floor = (int32_t)(minFreq + ((maxFreq - minFreq) * powerPrewakePolicy.minFreqPercent) / 100);
+            if (PLAT_API_QosAddRequest(PWRMGR_QOS_CPU_FREQ_MIN, floor, &prewake_qos) != PWRMGR_SUCCESS) {
+                prewake_qos = 0;
+            }
+        }
+    }
+    powerFreezerSetPrewake(powerPrewakePolicy.thawCgroupMask);
+    powerPrefetchStart();
+}
+
+static void prewakeStop(void)
+{
+    prewake_active = false;
+    if (0 != prewake_qos) {
+        PLAT_API_QosRemoveRequest(prewake_qos);
+        prewake_qos = 0;
+    }
+    powerFreezerSetPrewake(0);
+}
+
+/**
+ * @brief Load the persisted usage histogram.
+ * Must be called after powerFreezerInit() and before the worker thread is started.
+*/
+void powerPrewakeInit(void)
+{
+    prewake_active = false;
+    prewake_resumed_deep_sleep = false;
+    prewake_qos = 0;
+    prewakeLoad();
+    int likely = 0;
+    for (int bin = 0; bin < PREWAKE_BINS; bin++) {
+        likely += (prewake_histogram.counts[bin] >= powerPrewakePolicy.minObservations);
+    }
+    PWRMGR_LOG_INFO("%d likely wake hours per week", likely);
+}
+
+/**
+ * @brief End a running pre-wake.
+ * Must be called after the worker thread has been joined.
+*/
+void powerPrewakeTerm(void)
+{
+    if (prewake_active) {
+        prewakeStop();
+    }
+    powerAlarmSetPrewake(0);
+}
+
+/**
+ * @brief Worker action: end the pre-wake on ON.
+ * @param from The state being left.
+ * @param to The state being entered.
+ * @return true.
+*/
+bool powerPrewakeApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to)
+{
+    prewake_resumed_deep_sleep = false;
+    if (PWRMGR_POWERSTATE_ON != to) {
+        return true;
+    }
+    if (prewake_active) {
+        prewakeStop();
+    }
+    powerAlarmSetPrewake(0);
+    return true;
+}
+
+/**
+ * @brief Count a wake to ON the middleware asked for. Worker thread only.
+ * Automatic wakes must not be recorded.
+ * @param from The state the box woke from.
+*/
+void powerPrewakeRecordWake(PWRMgr_PowerState_t from)
+{
+    if (PWRMGR_POWERSTATE_STANDBY != from && PWRMGR_POWERSTATE_STANDBY_LIGHT_SLEEP != from &&
+        PWRMGR_POWERSTATE_STANDBY_DEEP_SLEEP != from) {
+        return;
+    }
+    time_t hourStart;
+    int bin = prewakeBin(time(NULL), &hourStart);
+    if (++prewake_histogram.counts[bin] >= PREWAKE_DECAY_COUNT) {
+        for (int i = 0; i < PREWAKE_BINS; i++) {
+            prewake_histogram.counts[i] /= 2;
+        }
+    }
+    prewakeStore();
+}
+
+/**
+ * @brief Get the worker deadline of the next pre-wake window edge.
+ * @return The deadline in monotonic ms, 0 if no window is known.
+*/
+uint64_t powerPrewakeNextDeadline(void)
+{
+    time_t windowStart;
+    time_t windowEnd;
+    time_t now = time(NULL);
+    if (!prewakeNextWindow(now, &windowStart, &windowEnd)) {
+        return 0;
+    }
+    time_t edge = (now < windowStart) ? windowStart : windowEnd;
+    return monotonicTimeMs() + (uint64_t)(edge - now) * 1000ULL;
+}
+
+/**
+ * @brief Start or end the pre-wake as windows open and close. Worker thread only.
+ * @param state The power state currently applied by the worker.
+*/
+void powerPrewakeService(PWRMgr_PowerState_t state)
+{
+    time_t windowStart = 0;
+    time_t windowEnd = 0;
+    time_t now = time(NULL);
+    bool standby = (PWRMGR_POWERSTATE_STANDBY == state || PWRMGR_POWERSTATE_STANDBY_LIGHT_SLEEP == state ||
+                    PWRMGR_POWERSTATE_STANDBY_DEEP_SLEEP == state);
+    bool found = standby && prewakeNextWindow(now, &windowStart, &windowEnd);
+    bool inWindow = found && now >= windowStart;
+
+    if (inWindow && !prewake_active) {
+        prewake_resumed_deep_sleep = (PWRMGR_POWERSTATE_STANDBY_DEEP_SLEEP == state) && powerSuspendIsEnabled();
+        prewakeStart();
+    } else if (!inWindow && prewake_active) {
+        PWRMGR_LOG_INFO("Pre-wake window closed");
+        prewakeStop();
+        if (prewake_resumed_deep_sleep) {
+            /* Woken from suspend-to-idle for nothing; go back down. */
+            prewake_resumed_deep_sleep = false;
+            powerMgrRequestAutomatic(state, PWRMGR_POWERSTATE_STANDBY_DEEP_SLEEP);
+        }
+    }
+    /* Have the RTC wake a suspended kernel for the next window. */
+    powerAlarmSetPrewake((found && !inWindow) ? windowStart : 0);
+}
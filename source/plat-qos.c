@@ -0,0 +1,430 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * PM-QoS style constraint aggregation.
+ * Each class keeps its requests in an indexed binary heap so that add, update
+ * and remove are O(log n) and the aggregate is always the heap top. The worker
+ * thread owns all writes to the cpufreq limits and /dev/cpu_dma_latency.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "plat-power-priv.h"
+
+#define CPU_FREQ_SCALING_MAX_FREQ_PATH  "/sys/devices/system/cpu/cpu0/cpufreq/scaling_max_freq"
+#define CPU_DMA_LATENCY_PATH            "/dev/cpu_dma_latency"
+
+typedef struct {
+    bool used;
+    uint16_t generation;
+    PWRMgr_QosClass_t qosClass;
+    int32_t value;
+    int heapIndex;
+} QosRequest_t;
+
+/* Request pool, free list and per class heaps. Guarded by qos_mutex. */
+static pthread_mutex_t qos_mutex = PTHREAD_MUTEX_INITIALIZER;
+static QosRequest_t qos_requests[PWRMGR_QOS_MAX_REQUESTS];
+static int qos_free_list[PWRMGR_QOS_MAX_REQUESTS];
+static int qos_free_count = 0;
+static int qos_heap[PWRMGR_QOS_MAX][PWRMGR_QOS_MAX_REQUESTS];
+static int qos_heap_size[PWRMGR_QOS_MAX];
+
+/* Baseline snapshot and applied shadow, only touched by the worker thread. */
+static long cpuinfo_min_freq = -1;
+static long cpuinfo_max_freq = -1;
+static long baseline_min_freq = -1;
+static long baseline_max_freq = -1;
+static long applied_min_freq = -1;
+static long applied_max_freq = -1;
+static int32_t applied_latency = PWRMGR_QOS_NO_CONSTRAINT;
+static int latency_fd = -1;
+static int32_t state_latency = PWRMGR_QOS_NO_CONSTRAINT;
+
+/**
+ * @brief Heap ordering: the frequency floor aggregates to the maximum,
+ * the frequency cap and the latency bound aggregate to the minimum.
+*/
+static bool qosHeapBefore(PWRMgr_QosClass_t qosClass, int a, int b)
+{
+    int32_t va = qos_requests[a].value;
+    int32_t vb = qos_requests[b].value;
+    return (PWRMGR_QOS_CPU_FREQ_MIN == qosClass) ? (va > vb) : (va < vb);
+}
+
+static void qosHeapSwap(PWRMgr_QosClass_t qosClass, int i, int j)
+{
+    int tmp = qos_heap[qosClass][i];
+    qos_heap[qosClass][i] = qos_heap[qosClass][j];
+    qos_heap[qosClass][j] = tmp;
+    qos_requests[qos_heap[qosClass][i]].heapIndex = i;
+    qos_requests[qos_heap[qosClass][j]].heapIndex = j;
+}
+
+static void qosHeapFix(PWRMgr_QosClass_t qosClass, int i)
+{
+    int *heap = qos_heap[qosClass];
+    while (i > 0 && qosHeapBefore(qosClass, heap[i], heap[(i - 1) / 2])) {
+        qosHeapSwap(qosClass, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    while (1) {
+        int first = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < qos_heap_size[qosClass] && qosHeapBefore(qosClass, heap[left], heap[first])) {
+            first = left;
+        }
+        if (right < qos_heap_size[qosClass] && qosHeapBefore(qosClass, heap[right], heap[first])) {
+            first = right;
+        }
+        if (first == i) {
+            break;
+        }
+        qosHeapSwap(qosClass, i, first);
+        i = first;
+    }
+}
+
+static int32_t qosHeapTop(PWRMgr_QosClass_t qosClass)
+{
+    if (0 == qos_heap_size[qosClass]) {
+        return PWRMGR_QOS_NO_CONSTRAINT;
+    }
+    return qos_requests[qos_heap[qosClass][0]].value;
+}
+
+/**
+ * @brief Resolve a handle to its request slot.
+ * @return The slot index, or -1 for a stale or invalid handle. Call with qos_mutex held.
+*/
+static int qosLookup(PWRMgr_QosHandle_t handle)
+{
+    int slot = (int)(handle & 0xFFFF) - 1;
+    uint16_t generation = (uint16_t)(handle >> 16);
+    if (slot < 0 || slot >= PWRMGR_QOS_MAX_REQUESTS ||
+        !qos_requests[slot].used || qos_requests[slot].generation != generation) {
+        return -1;
+    }
+    return slot;
+}
+
+static bool qosValueValid(PWRMgr_QosClass_t qosClass, int32_t value)
+{
+    return (qosClass >= PWRMGR_QOS_CPU_FREQ_MIN && qosClass < PWRMGR_QOS_MAX && value >= 0);
+}
+
+/**
+ * @brief Reset the request pool and snapshot the cpufreq limits.
+ * Must be called before the worker thread is started.
+*/
+void powerQosInit(void)
+{
+    pthread_mutex_lock(&qos_mutex);
+    memset(qos_requests, 0, sizeof(qos_requests));
+    memset(qos_heap_size, 0, sizeof(qos_heap_size));
+    qos_free_count = 0;
+    for (int slot = PWRMGR_QOS_MAX_REQUESTS - 1; slot >= 0; slot--) {
+        qos_free_list[qos_free_count++] = slot;
+    }
+    pthread_mutex_unlock(&qos_mutex);
+
+    if (!sysfsReadLong(CPU_FREQ_CPUINFO_MIN_FREQ_PATH, &cpuinfo_min_freq) ||
+        !sysfsReadLong(CPU_FREQ_CPUINFO_MAX_FREQ_PATH, &cpuinfo_max_freq)) {
+        PWRMGR_LOG_ERRNO("Failed to read cpuinfo frequency range, frequency constraints disabled");
+        cpuinfo_min_freq = cpuinfo_max_freq = -1;
+    }
+    /* After a restart the limits may still hold the previous instance's requests. */
+    if (!powerShadowReadBaselineLong(CPU_FREQ_SCALING_MIN_FREQ_PATH, &baseline_min_freq, &applied_min_freq)) {
+        baseline_min_freq = applied_min_freq = cpuinfo_min_freq;
+    }
+    if (!powerShadowReadBaselineLong(CPU_FREQ_SCALING_MAX_FREQ_PATH, &baseline_max_freq, &applied_max_freq)) {
+        baseline_max_freq = applied_max_freq = cpuinfo_max_freq;
+    }
+    applied_latency = PWRMGR_QOS_NO_CONSTRAINT;
+}
+
+/**
+ * @brief Write the cpufreq limits, ordering the writes so min never exceeds max.
+*/
+static void qosWriteFreqLimits(long minFreq, long maxFreq)
+{
+    bool maxFirst = (minFreq > applied_max_freq);
+    for (int pass = 0; pass < 2; pass++) {
+        bool writeMax = (pass == 0) ? maxFirst : !maxFirst;
+        if (writeMax && maxFreq != applied_max_freq) {
+            PWRMGR_LOG_INFO("Setting scaling_max_freq %ld kHz", maxFreq);
+            if (sysfsWriteLong(CPU_FREQ_SCALING_MAX_FREQ_PATH, maxFreq)) {
+                applied_max_freq = maxFreq;
+            } else {
+                PWRMGR_LOG_ERRNO("Failed to set scaling_max_freq");
+            }
+        } else if (!writeMax && minFreq != applied_min_freq) {
+            PWRMGR_LOG_INFO("Setting scaling_min_freq %ld kHz", minFreq);
+            if (sysfsWriteLong(CPU_FREQ_SCALING_MIN_FREQ_PATH, minFreq)) {
+                applied_min_freq = minFreq;
+            } else {
+                PWRMGR_LOG_ERRNO("Failed to set scaling_min_freq");
+            }
+        }
+    }
+}
+
+/**
+ * @brief Hold, update or release the /dev/cpu_dma_latency request.
+ * The kernel keeps the constraint for as long as the fd stays open.
+*/
+static void qosWriteLatency(int32_t latency)
+{
+    if (PWRMGR_QOS_NO_CONSTRAINT == latency) {
+        if (latency_fd >= 0) {
+            close(latency_fd);
+            latency_fd = -1;
+        }
+        applied_latency = latency;
+        return;
+    }
+    if (latency_fd < 0) {
+        char path[PWRMGR_PATH_MAX];
+        if (!sysfsResolvePath(CPU_DMA_LATENCY_PATH, path, sizeof(path))) {
+            return;
+        }
+        latency_fd = open(path, O_WRONLY | O_CLOEXEC);
+        if (latency_fd < 0) {
+            PWRMGR_LOG_ERRNO("Failed to open cpu_dma_latency");
+            return;
+        }
+    }
+    PWRMGR_LOG_INFO("Setting cpu_dma_latency %d us", latency);
+    if (write(latency_fd, &latency, sizeof(latency)) != sizeof(latency)) {
+        PWRMGR_LOG_ERRNO("Failed to write cpu_dma_latency");
+        return;
+    }
+    applied_latency = latency;
+}
+
+/**
+ * @brief Set the latency bound required by the current power state.
+ * Called from the worker thread; takes effect on the next powerQosApply().
+ * @param latencyUs The bound in us, 0 for none.
+*/
+void powerQosSetStateLatency(int32_t latencyUs)
+{
+    state_latency = (latencyUs > 0) ? latencyUs : PWRMGR_QOS_NO_CONSTRAINT;
+}
+
+/**
+ * @brief Recompute the effective constraints and write the ones that changed.
+ * The hint floor from powerHintFloorPercent() joins the client floor requests
+ * and the power state latency bound joins the client latency requests.
+ * Called from the worker thread.
+*/
+void powerQosApply(void)
+{
+    pthread_mutex_lock(&qos_mutex);
+    int32_t floorRequest = qosHeapTop(PWRMGR_QOS_CPU_FREQ_MIN);
+    int32_t capRequest = qosHeapTop(PWRMGR_QOS_CPU_FREQ_MAX);
+    int32_t latency = qosHeapTop(PWRMGR_QOS_CPU_LATENCY);
+    pthread_mutex_unlock(&qos_mutex);
+
+    if (state_latency != PWRMGR_QOS_NO_CONSTRAINT &&
+        (latency == PWRMGR_QOS_NO_CONSTRAINT || state_latency < latency)) {
+        latency = state_latency;
+    }
+
+    if (cpuinfo_min_freq >= 0) {
+        long minFreq = baseline_min_freq;
+        long maxFreq = baseline_max_freq;
+        int hintPercent = powerHintFloorPercent();
+        if (hintPercent >= 0) {
+            long hintFloor = cpuinfo_min_freq + ((cpuinfo_max_freq - cpuinfo_min_freq) * hintPercent) / 100;
+            minFreq = (hintFloor > minFreq) ? hintFloor : minFreq;
+        }
+        if (floorRequest != PWRMGR_QOS_NO_CONSTRAINT && floorRequest > minFreq) {
+            minFreq = floorRequest;
+        }
+        if (capRequest != PWRMGR_QOS_NO_CONSTRAINT && capRequest < maxFreq) {
+            maxFreq = capRequest;
+        }
+        /* Clamp into the hardware range; a cap below the floor wins over the floor. */
+        minFreq = (minFreq > cpuinfo_max_freq) ? cpuinfo_max_freq : minFreq;
+        maxFreq = (maxFreq < cpuinfo_min_freq) ? cpuinfo_min_freq : maxFreq;
+        minFreq = (minFreq > maxFreq) ? maxFreq : minFreq;
+        qosWriteFreqLimits(minFreq, maxFreq);
+    }
+
+    if (latency != applied_latency) {
+        qosWriteLatency(latency);
+    }
+}
+
+/**
+ * @brief Drop all requests, release the latency fd and restore the cpufreq limits.
+ * Must be called after the worker thread has been joined.
+*/
+void powerQosTerm(void)
+{
+    pthread_mutex_lock(&qos_mutex);
+    memset(qos_heap_size, 0, sizeof(qos_heap_size));
+    for (int slot = 0; slot < PWRMGR_QOS_MAX_REQUESTS; slot++) {
+        qos_requests[slot].used = false;
+    }
+    state_latency = PWRMGR_QOS_NO_CONSTRAINT;
+    pthread_mutex_unlock(&qos_mutex);
+
+    if (cpuinfo_min_freq >= 0) {
+        qosWriteFreqLimits(baseline_min_freq, baseline_max_freq);
+    }
+    qosWriteLatency(PWRMGR_QOS_NO_CONSTRAINT);
+}
+
+/**
+ * @brief Adds a QoS request.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_QosAddRequest(PWRMgr_QosClass_t qosClass, int32_t value, PWRMgr_QosHandle_t *handle)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (!qosValueValid(qosClass, value) || NULL == handle) {
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    if (pthread_mutex_lock(&qos_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_SET_FAILURE;
+    }
+    if (0 == qos_free_count) {
+        pthread_mutex_unlock(&qos_mutex);
+        PWRMGR_LOG_ERROR("No free request slots");
+        return PWRMGR_SET_FAILURE;
+    }
+    int32_t before = qosHeapTop(qosClass);
+    int slot = qos_free_list[--qos_free_count];
+    QosRequest_t *request = &qos_requests[slot];
+    request->used = true;
+    request->generation++;
+    request->qosClass = qosClass;
+    request->value = value;
+    request->heapIndex = qos_heap_size[qosClass]++;
+    qos_heap[qosClass][request->heapIndex] = slot;
+    qosHeapFix(qosClass, request->heapIndex);
+    *handle = ((PWRMgr_QosHandle_t)request->generation << 16) | (PWRMgr_QosHandle_t)(slot + 1);
+    bool changed = (qosHeapTop(qosClass) != before);
+    pthread_mutex_unlock(&qos_mutex);
+
+    if (changed) {
+        powerMgrWakeWorker();
+    }
+    return PWRMGR_SUCCESS;
+}
+
+/**
+ * @brief Updates the value of an existing QoS request.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_QosUpdateRequest(PWRMgr_QosHandle_t handle, int32_t value)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (pthread_mutex_lock(&qos_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_SET_FAILURE;
+    }
+    int slot = qosLookup(handle);
+    if (slot < 0 || !qosValueValid(qos_requests[slot].qosClass, value)) {
+        pthread_mutex_unlock(&qos_mutex);
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    PWRMgr_QosClass_t qosClass = qos_requests[slot].qosClass;
+    int32_t before = qosHeapTop(qosClass);
+    qos_requests[slot].value = value;
+    qosHeapFix(qosClass, qos_requests[slot].heapIndex);
+    bool changed = (qosHeapTop(qosClass) != before);
+    pthread_mutex_unlock(&qos_mutex);
+
+    if (changed) {
+        powerMgrWakeWorker();
+    }
+    return PWRMGR_SUCCESS;
+}
+
+/**
+ * @brief Removes a QoS request.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_QosRemoveRequest(PWRMgr_QosHandle_t handle)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (pthread_mutex_lock(&qos_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_SET_FAILURE;
+    }
+    int slot = qosLookup(handle);
+    if (slot < 0) {
+        pthread_mutex_unlock(&qos_mutex);
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    PWRMgr_QosClass_t qosClass = qos_requests[slot].qosClass;
+    int32_t before = qosHeapTop(qosClass);
+    int index = qos_requests[slot].heapIndex;
+    int last = --qos_heap_size[qosClass];
+    if (index != last) {
+        qos_heap[qosClass][index] = qos_heap[qosClass][last];
+        qos_requests[qos_heap[qosClass][index]].heapIndex = index;
+        qosHeapFix(qosClass, index);
+    }
+    qos_requests[slot].used = false;
+    qos_free_list[qos_free_count++] = slot;
+    bool changed = (qosHeapTop(qosClass) != before);
+    pthread_mutex_unlock(&qos_mutex);
+
+    if (changed) {
+        powerMgrWakeWorker();
+    }
+    return PWRMGR_SUCCESS;
+}
+
+/**
+ * @brief Gets the aggregated value of a QoS class.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_QosGetEffective(PWRMgr_QosClass_t qosClass, int32_t *value)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (!(qosClass >= PWRMGR_QOS_CPU_FREQ_MIN && qosClass < PWRMGR_QOS_MAX) || NULL == value) {
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    if (pthread_mutex_lock(&qos_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_GET_FAILURE;
+    }
+    *value = qosHeapTop(qosClass);
+    pthread_mutex_unlock(&qos_mutex);
+    return PWRMGR_SUCCESS;
+}
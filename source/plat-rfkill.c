@@ -0,0 +1,222 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Radio control. States with an rfkillBlockMask soft block the radios of
+ * those types through /dev/rfkill; the other states unblock the radios the
+ * HAL blocked, leaving alone any the user had blocked already. A radio type
+ * backing an enabled wakeup source (Wi-Fi, Bluetooth) stays up. The device
+ * list is kept current from the events the kernel queues on the open fd,
+ * drained before every transition, so no sysfs scan is needed.
+ *
+ * The action sits at the tail of the worker table, so on resume the radios
+ * are unblocked before anything else; firmware load and association then
+ * overlap with the rest of the resume instead of delaying the UI.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/rfkill.h>
+
+#include "plat-power-priv.h"
+
+#define RFKILL_DEVICE_PATH      "/dev/rfkill"
+#define RFKILL_MAX_RADIOS       8
+
+typedef struct {
+    uint32_t idx;
+    uint8_t type;
+    bool soft;
+    bool blockedByHal;
+} RfkillRadio_t;
+
+/* Only touched by the worker thread, or before it is started. */
+static int rfkill_fd = -1;
+static RfkillRadio_t rfkill_radios[RFKILL_MAX_RADIOS];
+static int rfkill_radio_count = 0;
+
+static RfkillRadio_t *rfkillFindRadio(uint32_t idx)
+{
+    for (int i = 0; i < rfkill_radio_count; i++) {
+        if (rfkill_radios[i].idx == idx) {
+            return &rfkill_radios[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Tell whether a radio found blocked was blocked by a previous instance.
+ * Its soft state at first sight since boot is kept in the state shadow.
+*/
+static bool rfkillBlockedByHal(uint32_t idx, bool soft)
+{
+    char path[PWRMGR_PATH_MAX];
+    char baseline[4] = {0};
+    snprintf(path, sizeof(path), "/sys/class/rfkill/rfkill%u/soft", idx);
+    if (!powerShadowReadBaseline(path, baseline, NULL, sizeof(baseline))) {
+        return false;
+    }
+    return soft && baseline[0] == '0';
+}
+
+/**
+ * @brief Apply the pending kernel events to the radio list.
+*/
+static void rfkillDrainEvents(void)
+{
+    struct rfkill_event event;
+    ssize_t len;
+    /* The kernel hands out one event per read(). */
+    while ((len = read(rfkill_fd, &event, sizeof(event))) > 0) {
+        if ((size_t)len < sizeof(event)) {
+            continue;
+        }
+        RfkillRadio_t *radio = rfkillFindRadio(event.idx);
+        switch (event.op) {
+            case RFKILL_OP_ADD:
+            case RFKILL_OP_CHANGE:
+                if (NULL == radio) {
+                    if (rfkill_radio_count == RFKILL_MAX_RADIOS) {
+                        PWRMGR_LOG_WARN("Too many radios, ignoring rfkill%u", event.idx);
+                        break;
+                    }
+                    radio = &rfkill_radios[rfkill_radio_count++];
+                    radio->idx = event.idx;
+                    radio->blockedByHal = rfkillBlockedByHal(event.idx, event.soft != 0);
+                }
+                radio->type = event.type;
+                radio->soft = (event.soft != 0);
+                break;
+            case RFKILL_OP_DEL:
+                if (NULL != radio) {
+                    *radio = rfkill_radios[--rfkill_radio_count];
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if (len < 0 && EAGAIN != errno && EINTR != errno) {
+        PWRMGR_LOG_ERRNO("Failed to read rfkill events");
+    }
+}
+
+static bool rfkillSetSoft(RfkillRadio_t *radio, bool block)
+{
+    struct rfkill_event event;
+    memset(&event, 0, sizeof(event));
+    event.idx = radio->idx;
+    event.op = RFKILL_OP_CHANGE;
+    event.soft = block ? 1 : 0;
+    if (write(rfkill_fd, &event, sizeof(event)) != sizeof(event)) {
+        PWRMGR_LOG_ERRNO("Failed to write rfkill event");
+        return false;
+    }
+    radio->soft = block;
+    radio->blockedByHal = block;
+    return true;
+}
+
+/**
+ * @brief Get the radio types a state blocks, minus the ones needed for wakeup.
+*/
+static uint32_t rfkillBlockMask(PWRMgr_PowerState_t state)
+{
+    uint32_t mask = powerStatePolicy[state].rfkillBlockMask;
+    if (powerWakeupIsEnabled(PWRMGR_WAKEUPSRC_WIFI)) {
+        mask &= ~(1U << RFKILL_TYPE_WLAN);
+    }
+    if (powerWakeupIsEnabled(PWRMGR_WAKEUPSRC_BLUETOOTH)) {
+        mask &= ~(1U << RFKILL_TYPE_BLUETOOTH);
+    }
+    return mask;
+}
+
+/**
+ * @brief Block the radios of a type mask and unblock the others the HAL blocked.
+ * @return true if every change was accepted.
+*/
+static bool rfkillApplyMask(uint32_t mask)
+{
+    bool success = true;
+    rfkillDrainEvents();
+    for (int i = 0; i < rfkill_radio_count; i++) {
+        RfkillRadio_t *radio = &rfkill_radios[i];
+        bool block = radio->type < 32 && (mask & (1U << radio->type)) != 0;
+        if (block && !radio->soft) {
+            success = rfkillSetSoft(radio, true) && success;
+        } else if (!block && radio->blockedByHal) {
+            success = rfkillSetSoft(radio, false) && success;
+        }
+    }
+    return success;
+}
+
+/**
+ * @brief Open /dev/rfkill and learn the present radios.
+ * Must be called before the worker thread is started.
+*/
+void powerRfkillInit(void)
+{
+    char path[PWRMGR_PATH_MAX];
+    rfkill_radio_count = 0;
+    if (!sysfsResolvePath(RFKILL_DEVICE_PATH, path, sizeof(path))) {
+        return;
+    }
+    rfkill_fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (rfkill_fd < 0) {
+        PWRMGR_LOG_ERRNO("Failed to open rfkill");
+        return;
+    }
+    /* Opening queues an RFKILL_OP_ADD for every radio already registered. */
+    rfkillDrainEvents();
+    PWRMGR_LOG_INFO("%d radios", rfkill_radio_count);
+}
+
+/**
+ * @brief Worker action: block the radios of the target state.
+ * @param from The state being left.
+ * @param to The state being entered.
+ * @return true if successful or rfkill is not available.
+*/
+bool powerRfkillApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to)
+{
+    (void)from;
+    if (rfkill_fd < 0) {
+        return true;
+    }
+    return rfkillApplyMask(rfkillBlockMask(to));
+}
+
+/**
+ * @brief Unblock the radios the HAL blocked and close /dev/rfkill.
+ * Must be called after the worker thread has been joined.
+*/
+void powerRfkillTerm(void)
+{
+    if (rfkill_fd < 0) {
+        return;
+    }
+    rfkillApplyMask(0);
+    close(rfkill_fd);
+    rfkill_fd = -1;
+}
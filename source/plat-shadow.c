@@ -0,0 +1,261 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * State shadow. The last applied power state and the baseline of every knob
+ * the modules snapshot at init are kept in /run, which lives until the next
+ * reboot. When the middleware restarts, PLAT_INIT() picks the state back up
+ * and the modules, which snapshot through powerShadowReadBaseline(), take
+ * their baselines from the shadow instead of from knobs the previous
+ * instance had already moved; the current values only tell them what is
+ * applied. The worker then reconciles the two in one pass that writes just
+ * the knobs that differ, instead of a transition to ON.
+ * PLAT_TERM() restores the baselines itself and removes the shadow.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "plat-power-priv.h"
+
+#define SHADOW_STATE_PATH       "/run/pwrmgr.state"
+#define SHADOW_BASELINE_PATH    "/run/pwrmgr.baseline"
+#define SHADOW_MAX_ENTRIES      256
+#define SHADOW_VALUE_MAX        128
+
+typedef struct {
+    char path[PWRMGR_PATH_MAX];
+    char value[SHADOW_VALUE_MAX];
+} ShadowEntry_t;
+
+/* Only touched by PLAT_INIT(), PLAT_TERM() and the worker thread. */
+static ShadowEntry_t shadow_entries[SHADOW_MAX_ENTRIES];
+static int shadow_entry_count = 0;
+static int shadow_stored_count = 0;
+static bool shadow_state_valid = false;
+static PWRMgr_PowerState_t shadow_state = PWRMGR_POWERSTATE_ON;
+
+static ShadowEntry_t *shadowFind(const char *path)
+{
+    for (int i = 0; i < shadow_entry_count; i++) {
+        if (strcmp(shadow_entries[i].path, path) == 0) {
+            return &shadow_entries[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Write a shadow file aside and rename it into place.
+*/
+static void shadowWriteFile(const char *file, const char *data, size_t length)
+{
+    char path[PWRMGR_PATH_MAX];
+    char temp[PWRMGR_PATH_MAX];
+    if (!sysfsResolvePath(file, path, sizeof(path)) ||
+        snprintf(temp, sizeof(temp), "%s.tmp", path) >= (int)sizeof(temp)) {
+        return;
+    }
+    int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        PWRMGR_LOG_ERRNO("Failed to open shadow");
+        return;
+    }
+    bool written = write(fd, data, length) == (ssize_t)length;
+    close(fd);
+    if (!written || rename(temp, path) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to store shadow");
+        unlink(temp);
+    }
+}
+
+static void shadowLoadBaselines(void)
+{
+    char path[PWRMGR_PATH_MAX];
+    char line[PWRMGR_PATH_MAX + SHADOW_VALUE_MAX + 2];
+    if (!sysfsResolvePath(SHADOW_BASELINE_PATH, path, sizeof(path))) {
+        return;
+    }
+    FILE *fp = fopen(path, "re");
+    if (NULL == fp) {
+        return;
+    }
+    /* One "<path>\t<value>" per line. */
+    while (NULL != fgets(line, sizeof(line), fp) && shadow_entry_count < SHADOW_MAX_ENTRIES) {
+        line[strcspn(line, "\n")] = '\0';
+        char *separator = strchr(line, '\t');
+        if (NULL == separator || (size_t)(separator - line) >= PWRMGR_PATH_MAX) {
+            continue;
+        }
+        *separator = '\0';
+        ShadowEntry_t *entry = &shadow_entries[shadow_entry_count++];
+        memcpy(entry->path, line, (size_t)(separator - line) + 1);
+        snprintf(entry->value, sizeof(entry->value), "%s", separator + 1);
+    }
+    fclose(fp);
+}
+
+/**
+ * @brief Load the shadow left by a previous instance since the last reboot.
+ * Must be called at PLAT_INIT() before any module snapshots its baselines.
+*/
+void powerShadowInit(void)
+{
+    long state = 0;
+    shadow_entry_count = 0;
+    shadow_state_valid = false;
+    shadow_state = PWRMGR_POWERSTATE_ON;
+    shadowLoadBaselines();
+    shadow_stored_count = shadow_entry_count;
+    if (sysfsReadLong(SHADOW_STATE_PATH, &state) &&
+        /* OFF is only stored if the power off failed; start over from ON then. */
+        state > PWRMGR_POWERSTATE_OFF && state < PWRMGR_POWERSTATE_MAX) {
+        shadow_state = (PWRMgr_PowerState_t)state;
+        shadow_state_valid = true;
+    }
+    if (shadow_state_valid) {
+        PWRMGR_LOG_INFO("Restarted in '%s', %d baselines restored",
+                         rdkPowerStateToString(shadow_state), shadow_entry_count);
+    }
+}
+
+/**
+ * @brief Get the power state the previous instance had applied.
+ * @param state Set to that state.
+ * @return false on the first PLAT_INIT() since boot.
+*/
+bool powerShadowRestoredState(PWRMgr_PowerState_t *state)
+{
+    *state = shadow_state;
+    return shadow_state_valid;
+}
+
+/**
+ * @brief Read a knob together with its baseline.
+ * The baseline is the value recorded by the first instance since boot, or
+ * the current value, which is then recorded, if there is none yet.
+ * @param path The knob.
+ * @param baseline The buffer receiving the baseline.
+ * @param current The buffer receiving the current value, may be NULL.
+ * @param size The size of both buffers.
+ * @return false if the knob cannot be read now, like sysfsReadString().
+*/
+bool powerShadowReadBaseline(const char *path, char *baseline, char *current, size_t size)
+{
+    char value[SHADOW_VALUE_MAX] = {0};
+    if (!sysfsReadString(path, value, sizeof(value))) {
+        return false;
+    }
+    if (NULL != current) {
+        snprintf(current, size, "%s", value);
+    }
+    ShadowEntry_t *entry = shadowFind(path);
+    if (NULL == entry) {
+        if (shadow_entry_count == SHADOW_MAX_ENTRIES || strlen(path) >= PWRMGR_PATH_MAX ||
+            NULL != strpbrk(value, "\t\n")) {
+            /* Not restorable after a restart; the current value has to do. */
+            snprintf(baseline, size, "%s", value);
+            return true;
+        }
+        entry = &shadow_entries[shadow_entry_count++];
+        snprintf(entry->path, sizeof(entry->path), "%s", path);
+        snprintf(entry->value, sizeof(entry->value), "%s", value);
+    }
+    snprintf(baseline, size, "%s", entry->value);
+    return true;
+}
+
+/**
+ * @brief powerShadowReadBaseline() for decimal knobs.
+ * @param current Receives the current value, may be NULL.
+*/
+bool powerShadowReadBaselineLong(const char *path, long *baseline, long *current)
+{
+    char baselineValue[32] = {0};
+    char currentValue[32] = {0};
+    char *end = NULL;
+    if (!powerShadowReadBaseline(path, baselineValue, currentValue, sizeof(baselineValue))) {
+        return false;
+    }
+    long parsedBaseline = strtol(baselineValue, &end, 10);
+    if (end == baselineValue) {
+        errno = EINVAL;
+        return false;
+    }
+    long parsedCurrent = strtol(currentValue, &end, 10);
+    if (end == currentValue) {
+        errno = EINVAL;
+        return false;
+    }
+    *baseline = parsedBaseline;
+    if (NULL != current) {
+        *current = parsedCurrent;
+    }
+    return true;
+}
+
+/**
+ * @brief Store the baselines recorded since the last call.
+ * Called once all modules are initialized.
+*/
+void powerShadowCommit(void)
+{
+    static char data[SHADOW_MAX_ENTRIES * (PWRMGR_PATH_MAX + SHADOW_VALUE_MAX + 2)];
+    size_t length = 0;
+    if (shadow_entry_count == shadow_stored_count) {
+        return;
+    }
+    for (int i = 0; i < shadow_entry_count; i++) {
+        length += snprintf(data + length, sizeof(data) - length, "%s\t%s\n",
+                           shadow_entries[i].path, shadow_entries[i].value);
+    }
+    shadowWriteFile(SHADOW_BASELINE_PATH, data, length);
+    shadow_stored_count = shadow_entry_count;
+}
+
+/**
+ * @brief Record the power state the worker has applied. Worker thread only.
+*/
+void powerShadowStoreState(PWRMgr_PowerState_t state)
+{
+    char data[16];
+    int length = snprintf(data, sizeof(data), "%d\n", (int)state);
+    shadowWriteFile(SHADOW_STATE_PATH, data, (size_t)length);
+}
+
+/**
+ * @brief Remove the shadow once the modules have restored their baselines.
+ * Must be called at the end of PLAT_TERM().
+*/
+void powerShadowTerm(void)
+{
+    char path[PWRMGR_PATH_MAX];
+    if (sysfsResolvePath(SHADOW_STATE_PATH, path, sizeof(path))) {
+        unlink(path);
+    }
+    if (sysfsResolvePath(SHADOW_BASELINE_PATH, path, sizeof(path))) {
+        unlink(path);
+    }
+    shadow_entry_count = 0;
+    shadow_stored_count = 0;
+    shadow_state_valid = false;
+}
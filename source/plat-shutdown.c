@@ -0,0 +1,270 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Shutdown pipeline run before powering off or rebooting. Every writable
+ * block device mount is remounted read-only on its own thread, so a slow SD
+ * card and a USB disk flush in parallel; remounting flushes the filesystem
+ * itself. A mount that refuses (files still open for writing) is syncfs()ed
+ * instead, which only touches that filesystem rather than every dirty inode
+ * in the system. Each mount gets SHUTDOWN_MOUNT_TIMEOUT_MS; a mount still
+ * busy by then is abandoned so the box always powers off in bounded time.
+ * If the power off itself fails, powerShutdownAbort() makes the mounts
+ * writable again so the HAL keeps its journal and state files.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <mntent.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include <sys/statvfs.h>
+
+#include "plat-power-priv.h"
+
+#define PROC_MOUNTS_PATH            "/proc/self/mounts"
+#define SHUTDOWN_MAX_MOUNTS         16
+#define SHUTDOWN_MOUNT_TIMEOUT_MS   3000
+
+typedef enum {
+    SHUTDOWN_MOUNT_PENDING = 0,
+    SHUTDOWN_MOUNT_READ_ONLY,       ///< Remounted read-only
+    SHUTDOWN_MOUNT_SYNCED,          ///< Still writable, syncfs() completed
+    SHUTDOWN_MOUNT_FAILED,
+} ShutdownMountResult_t;
+
+typedef struct {
+    char target[PWRMGR_PATH_MAX];
+    unsigned long flags;            ///< Per-mount flags to keep across the remounts
+    ShutdownMountResult_t result;
+    uint32_t durationUs;
+} ShutdownMount_t;
+
+/*
+ * Static so a thread abandoned at its timeout never writes to a dead stack.
+ * The mounts are only touched under shutdown_mutex.
+ */
+static pthread_mutex_t shutdown_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t shutdown_cond = PTHREAD_COND_INITIALIZER;
+static ShutdownMount_t shutdown_mounts[SHUTDOWN_MAX_MOUNTS];
+static int shutdown_mount_count = 0;
+static int shutdown_pending = 0;
+static bool shutdown_aborted = false;
+
+/**
+ * @brief Get the per-mount flags a remount has to pass again to keep them.
+*/
+static unsigned long shutdownMountFlags(const char *target)
+{
+    static const struct {
+        unsigned long st;
+        unsigned long ms;
+    } flags[] = {
+        { ST_NOSUID, MS_NOSUID }, { ST_NODEV, MS_NODEV }, { ST_NOEXEC, MS_NOEXEC },
+        { ST_SYNCHRONOUS, MS_SYNCHRONOUS }, { ST_NOATIME, MS_NOATIME },
+        { ST_NODIRATIME, MS_NODIRATIME }, { ST_RELATIME, MS_RELATIME },
+    };
+    struct statvfs info;
+    unsigned long result = 0;
+    if (statvfs(target, &info) != 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+        if (info.f_flag & flags[i].st) {
+            result |= flags[i].ms;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Make a mount remounted read-only writable again.
+ * Called with shutdown_mutex held.
+*/
+static void shutdownRestoreMount(ShutdownMount_t *job)
+{
+    if (mount(NULL, job->target, NULL, MS_REMOUNT | job->flags, NULL) == 0) {
+        job->result = SHUTDOWN_MOUNT_PENDING;
+        PWRMGR_LOG_INFO("'%s' writable again", job->target);
+    } else {
+        PWRMGR_LOG_ERRNO("Failed to remount '%s' read-write", job->target);
+    }
+}
+
+static void *shutdownMountThread(void *arg)
+{
+    ShutdownMount_t *job = (ShutdownMount_t *)arg;
+    ShutdownMountResult_t result = SHUTDOWN_MOUNT_FAILED;
+    uint64_t start = monotonicTimeUs();
+
+    job->flags = shutdownMountFlags(job->target);
+    if (mount(NULL, job->target, NULL, MS_REMOUNT | MS_RDONLY | job->flags, NULL) == 0) {
+        result = SHUTDOWN_MOUNT_READ_ONLY;
+    } else {
+        int fd = open(job->target, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd >= 0) {
+            if (syncfs(fd) == 0) {
+                result = SHUTDOWN_MOUNT_SYNCED;
+            }
+            close(fd);
+        }
+    }
+
+    pthread_mutex_lock(&shutdown_mutex);
+    job->result = result;
+    job->durationUs = (uint32_t)(monotonicTimeUs() - start);
+    if (shutdown_aborted && SHUTDOWN_MOUNT_READ_ONLY == result) {
+        /* Abandoned at its timeout and the power off has failed since. */
+        shutdownRestoreMount(job);
+    }
+    shutdown_pending--;
+    pthread_cond_signal(&shutdown_cond);
+    pthread_mutex_unlock(&shutdown_mutex);
+    return NULL;
+}
+
+/**
+ * @brief Collect the writable mounts backed by a block device.
+ * Called with shutdown_mutex held.
+*/
+static void shutdownCollectMounts(void)
+{
+    char path[PWRMGR_PATH_MAX];
+    struct mntent entry;
+    char buffer[1024];
+    shutdown_mount_count = 0;
+    if (!sysfsResolvePath(PROC_MOUNTS_PATH, path, sizeof(path))) {
+        return;
+    }
+    FILE *fp = setmntent(path, "re");
+    if (NULL == fp) {
+        PWRMGR_LOG_ERRNO("Failed to open mounts");
+        return;
+    }
+    while (NULL != getmntent_r(fp, &entry, buffer, sizeof(buffer))) {
+        if (strncmp(entry.mnt_fsname, "/dev/", 5) != 0 || NULL != hasmntopt(&entry, MNTOPT_RO)) {
+            continue;
+        }
+        if (shutdown_mount_count == SHUTDOWN_MAX_MOUNTS || strlen(entry.mnt_dir) >= PWRMGR_PATH_MAX) {
+            PWRMGR_LOG_WARN("Ignoring mount '%s'", entry.mnt_dir);
+            continue;
+        }
+        ShutdownMount_t *job = &shutdown_mounts[shutdown_mount_count++];
+        snprintf(job->target, sizeof(job->target), "%s", entry.mnt_dir);
+        job->flags = 0;
+        job->result = SHUTDOWN_MOUNT_PENDING;
+        job->durationUs = 0;
+    }
+    endmntent(fp);
+}
+
+/**
+ * @brief Flush and remount read-only every writable block device mount.
+ * Returns once every mount is done or SHUTDOWN_MOUNT_TIMEOUT_MS has passed.
+ * @return true if every mount was remounted read-only or synced in time.
+*/
+bool powerShutdownPrepare(void)
+{
+    pthread_attr_t attr;
+    struct timespec deadline;
+    uint64_t start = monotonicTimeUs();
+    int failed = 0;
+    int readOnly = 0;
+
+    pthread_mutex_lock(&shutdown_mutex);
+    if (shutdown_pending > 0) {
+        /* A failed power off retried through PLAT_Reset(); the slots are still in use. */
+        PWRMGR_LOG_ERROR("%d mounts of the last run still busy", shutdown_pending);
+        pthread_mutex_unlock(&shutdown_mutex);
+        return false;
+    }
+    shutdownCollectMounts();
+    shutdown_pending = 0;
+    shutdown_aborted = false;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (int i = 0; i < shutdown_mount_count; i++) {
+        pthread_t thread;
+        shutdown_pending++;
+        if (pthread_create(&thread, &attr, shutdownMountThread, &shutdown_mounts[i]) != 0) {
+            PWRMGR_LOG_ERRNO("Failed to create mount thread");
+            shutdown_pending--;
+            shutdown_mounts[i].result = SHUTDOWN_MOUNT_FAILED;
+        }
+    }
+    pthread_attr_destroy(&attr);
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += SHUTDOWN_MOUNT_TIMEOUT_MS / 1000;
+    deadline.tv_nsec += (SHUTDOWN_MOUNT_TIMEOUT_MS % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    while (shutdown_pending > 0) {
+        if (pthread_cond_timedwait(&shutdown_cond, &shutdown_mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    for (int i = 0; i < shutdown_mount_count; i++) {
+        const ShutdownMount_t *job = &shutdown_mounts[i];
+        switch (job->result) {
+            case SHUTDOWN_MOUNT_READ_ONLY:
+                readOnly++;
+                PWRMGR_LOG_INFO("'%s' read-only in %u us", job->target, job->durationUs);
+                break;
+            case SHUTDOWN_MOUNT_SYNCED:
+                PWRMGR_LOG_INFO("'%s' busy, synced in %u us", job->target, job->durationUs);
+                break;
+            case SHUTDOWN_MOUNT_PENDING:
+                failed++;
+                PWRMGR_LOG_ERROR("'%s' timed out after %d ms", job->target, SHUTDOWN_MOUNT_TIMEOUT_MS);
+                break;
+            default:
+                failed++;
+                PWRMGR_LOG_ERROR("'%s' could not be flushed", job->target);
+                break;
+        }
+    }
+    PWRMGR_LOG_INFO("%d of %d mounts read-only, %d failed, %llu us",
+                     readOnly, shutdown_mount_count, failed, (unsigned long long)(monotonicTimeUs() - start));
+    pthread_mutex_unlock(&shutdown_mutex);
+    return (0 == failed);
+}
+
+/**
+ * @brief Undo powerShutdownPrepare() after the power off or reboot failed.
+ * Mounts still busy from it are made writable once they finish.
+*/
+void powerShutdownAbort(void)
+{
+    pthread_mutex_lock(&shutdown_mutex);
+    shutdown_aborted = true;
+    for (int i = 0; i < shutdown_mount_count; i++) {
+        if (SHUTDOWN_MOUNT_READ_ONLY == shutdown_mounts[i].result) {
+            shutdownRestoreMount(&shutdown_mounts[i]);
+        }
+    }
+    pthread_mutex_unlock(&shutdown_mutex);
+}
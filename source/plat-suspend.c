@@ -0,0 +1,211 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Suspend-to-idle for PWRMGR_POWERSTATE_STANDBY_DEEP_SLEEP, built with
+ * --enable-suspendtoidle. The worker runs the pre-suspend hooks in order,
+ * writes "freeze" to /sys/power/state, which blocks until a wakeup event
+ * resumes the kernel, and then runs the post-resume hooks in reverse order.
+ * A failing pre-suspend hook aborts the entry and unwinds the hooks before it.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "plat-power-priv.h"
+
+#define SYS_POWER_STATE_PATH    "/sys/power/state"
+#define SUSPEND_TO_IDLE_STATE   "freeze"
+
+static pthread_mutex_t suspend_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool suspend_supported = false;
+static PWRMgr_SuspendStats_t suspend_stats;
+static uint64_t suspend_resume_start_us = 0;
+
+#ifdef ENABLE_SUSPEND_TO_IDLE
+
+typedef struct {
+    const char *name;
+    bool (*preSuspend)(void);
+    void (*postResume)(void);
+} SuspendHook_t;
+
+/**
+ * @brief Refuse to suspend when nothing could wake the box up again.
+*/
+static bool suspendArmWakeSources(void)
+{
+    bool armed = false;
+    for (int src = PWRMGR_WAKEUPSRC_VOICE; src < PWRMGR_WAKEUPSRC_MAX; src++) {
+        armed = armed || powerWakeupIsEnabled((PWRMGR_WakeupSrcType_t)src);
+    }
+    if (!armed) {
+        PWRMGR_LOG_ERROR("No wakeup source enabled");
+        return false;
+    }
+    /* Make sure the RTC carries the earliest queued alarm. */
+    powerAlarmSync();
+    return true;
+}
+
+static const SuspendHook_t suspendHooks[] = {
+    { "cgroup-freeze",  powerFreezerSuspend,    powerFreezerResume },
+    { "wakeup-sources", suspendArmWakeSources,  NULL },
+};
+
+static uint64_t suspendBoottimeUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+static void suspendRunPostResume(size_t done)
+{
+    while (done-- > 0) {
+        if (NULL != suspendHooks[done].postResume) {
+            suspendHooks[done].postResume();
+        }
+    }
+}
+
+#endif /* ENABLE_SUSPEND_TO_IDLE */
+
+/**
+ * @brief Probe whether the kernel offers suspend-to-idle.
+ * Must be called before the worker thread is started.
+*/
+void powerSuspendInit(void)
+{
+    char states[64] = {0};
+    pthread_mutex_lock(&suspend_mutex);
+    memset(&suspend_stats, 0, sizeof(suspend_stats));
+    suspend_supported = false;
+    suspend_resume_start_us = 0;
+#ifdef ENABLE_SUSPEND_TO_IDLE
+    suspend_supported = sysfsReadString(SYS_POWER_STATE_PATH, states, sizeof(states)) &&
+                        NULL != strstr(states, SUSPEND_TO_IDLE_STATE);
+#endif
+    pthread_mutex_unlock(&suspend_mutex);
+    PWRMGR_LOG_INFO("suspend-to-idle %s ('%s')", suspend_supported ? "enabled" : "disabled", states);
+}
+
+/**
+ * @brief Check whether deep sleep enters suspend-to-idle.
+*/
+bool powerSuspendIsEnabled(void)
+{
+    return suspend_supported;
+}
+
+/**
+ * @brief Enter suspend-to-idle and return once resumed. Worker thread only.
+ * @return true if the kernel suspended, false if the entry was aborted.
+*/
+bool powerSuspendToIdle(void)
+{
+#ifdef ENABLE_SUSPEND_TO_IDLE
+    const size_t count = sizeof(suspendHooks) / sizeof(suspendHooks[0]);
+    size_t done = 0;
+    for (; done < count; done++) {
+        if (!suspendHooks[done].preSuspend()) {
+            PWRMGR_LOG_ERROR("Pre-suspend hook '%s' failed, aborting", suspendHooks[done].name);
+            break;
+        }
+    }
+    bool suspended = false;
+    uint64_t sleepUs = 0;
+    if (done == count) {
+        PWRMGR_LOG_INFO("Entering suspend-to-idle");
+        uint64_t monotonicStart = monotonicTimeUs();
+        uint64_t boottimeStart = suspendBoottimeUs();
+        /* Blocks until a wakeup event has resumed the kernel and thawed user space. */
+        suspended = sysfsWriteString(SYS_POWER_STATE_PATH, SUSPEND_TO_IDLE_STATE);
+        if (!suspended) {
+            PWRMGR_LOG_ERRNO("Failed to enter suspend-to-idle");
+        }
+        /* CLOCK_MONOTONIC stops while suspended, CLOCK_BOOTTIME does not. */
+        uint64_t boottimeDelta = suspendBoottimeUs() - boottimeStart;
+        uint64_t monotonicDelta = monotonicTimeUs() - monotonicStart;
+        sleepUs = (boottimeDelta > monotonicDelta) ? (boottimeDelta - monotonicDelta) : 0;
+    }
+    uint64_t resumeStart = monotonicTimeUs();
+    suspendRunPostResume(done);
+
+    pthread_mutex_lock(&suspend_mutex);
+    if (suspended) {
+        suspend_stats.suspendCount++;
+        suspend_stats.lastSleepUs = sleepUs;
+        suspend_resume_start_us = resumeStart;
+    } else {
+        suspend_stats.failCount++;
+    }
+    pthread_mutex_unlock(&suspend_mutex);
+    if (suspended) {
+        PWRMGR_LOG_INFO("Resumed after %llu us asleep, post-resume hooks took %llu us",
+                         (unsigned long long)sleepUs, (unsigned long long)(monotonicTimeUs() - resumeStart));
+    }
+    return suspended;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Close the resume latency measurement once the worker has finished
+ * the pass that resumed from suspend-to-idle. Worker thread only.
+*/
+void powerSuspendResumeComplete(void)
+{
+    pthread_mutex_lock(&suspend_mutex);
+    if (0 != suspend_resume_start_us) {
+        uint32_t resumeUs = (uint32_t)(monotonicTimeUs() - suspend_resume_start_us);
+        suspend_stats.lastResumeUs = resumeUs;
+        if (resumeUs > suspend_stats.maxResumeUs) {
+            suspend_stats.maxResumeUs = resumeUs;
+        }
+        suspend_resume_start_us = 0;
+    }
+    pthread_mutex_unlock(&suspend_mutex);
+}
+
+/**
+ * @brief Gets the suspend-to-idle statistics.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_GetSuspendStats(PWRMgr_SuspendStats_t *stats)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (NULL == stats) {
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    if (!suspend_supported) {
+        return PWRMGR_OPERATION_NOT_SUPPORTED;
+    }
+    if (pthread_mutex_lock(&suspend_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_GET_FAILURE;
+    }
+    *stats = suspend_stats;
+    pthread_mutex_unlock(&suspend_mutex);
+    return PWRMGR_SUCCESS;
+}
@@ -0,0 +1,214 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "plat-power-priv.h"
+
+/**
+ * @brief Get the root prefix of the kernel interface tree.
+ * @return The value of PWRMGR_SYSFS_ROOT, or an empty string for the real tree.
+*/
+const char *sysfsRoot(void)
+{
+    const char *root = getenv(PWRMGR_SYSFS_ROOT_ENV);
+    return (root != NULL) ? root : "";
+}
+
+/**
+ * @brief Resolve a kernel interface path against the sysfs root.
+ * @param path The absolute path as seen on the target.
+ * @param resolved The buffer to store the resolved path.
+ * @param size The size of the buffer.
+ * @return true if successful, false if the path does not fit.
+*/
+bool sysfsResolvePath(const char *path, char *resolved, size_t size)
+{
+    if (NULL == path || NULL == resolved) {
+        return false;
+    }
+    int len = snprintf(resolved, size, "%s%s", sysfsRoot(), path);
+    if (len < 0 || (size_t)len >= size) {
+        PWRMGR_LOG_ERROR("Path too long '%s'", path);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Read a single value from a sysfs attribute, trailing newline stripped.
+ * @param path The attribute path.
+ * @param value The buffer to store the value.
+ * @param size The size of the buffer.
+ * @return true if successful, false otherwise; errno is preserved on failure.
+*/
+bool sysfsReadString(const char *path, char *value, size_t size)
+{
+    char resolved[PWRMGR_PATH_MAX];
+    if (NULL == value || 0 == size || !sysfsResolvePath(path, resolved, sizeof(resolved))) {
+        return false;
+    }
+    int fd = open(resolved, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t len = read(fd, value, size - 1);
+    int saved = errno;
+    close(fd);
+    if (len < 0) {
+        errno = saved;
+        return false;
+    }
+    value[len] = '\0';
+    while (len > 0 && (value[len - 1] == '\n' || value[len - 1] == ' ')) {
+        value[--len] = '\0';
+    }
+    return true;
+}
+
+/**
+ * @brief Write a value to a sysfs attribute in a single write() call.
+ * @param path The attribute path.
+ * @param value The value to write.
+ * @return true if successful, false otherwise; errno is preserved on failure.
+*/
+bool sysfsWriteString(const char *path, const char *value)
+{
+    char resolved[PWRMGR_PATH_MAX];
+    if (NULL == value || !sysfsResolvePath(path, resolved, sizeof(resolved))) {
+        return false;
+    }
+    int fd = open(resolved, O_WRONLY | O_TRUNC | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    size_t len = strlen(value);
+    ssize_t written = write(fd, value, len);
+    int saved = errno;
+    close(fd);
+    if (written < 0 || (size_t)written != len) {
+        errno = (written < 0) ? saved : EIO;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Read a decimal integer from a sysfs attribute.
+ * @param path The attribute path.
+ * @param value The parsed value.
+ * @return true if successful, false otherwise.
+*/
+bool sysfsReadLong(const char *path, long *value)
+{
+    char buffer[32] = {0};
+    char *end = NULL;
+    if (NULL == value || !sysfsReadString(path, buffer, sizeof(buffer))) {
+        return false;
+    }
+    errno = 0;
+    long parsed = strtol(buffer, &end, 10);
+    if (errno != 0 || end == buffer) {
+        errno = EINVAL;
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+/**
+ * @brief Write a decimal integer to a sysfs attribute.
+ * @param path The attribute path.
+ * @param value The value to write.
+ * @return true if successful, false otherwise.
+*/
+bool sysfsWriteLong(const char *path, long value)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%ld", value);
+    return sysfsWriteString(path, buffer);
+}
+
+/**
+ * @brief Expand a glob pattern in the kernel interface tree.
+ * Symlinks are resolved so the same node reached through /sys/class and
+ * /sys/devices yields the same path. Paths are reported without the sysfs root.
+ * @param pattern The glob(3) pattern as seen on the target.
+ * @param callback Invoked once per match with the canonical path.
+ * @param context Passed through to the callback.
+ * @return The number of matches.
+*/
+int sysfsGlob(const char *pattern, void (*callback)(const char *path, void *context), void *context)
+{
+    char resolved[PWRMGR_PATH_MAX];
+    char root[PATH_MAX] = {0};
+    glob_t matches;
+    int count = 0;
+
+    if (NULL == callback || !sysfsResolvePath(pattern, resolved, sizeof(resolved))) {
+        return 0;
+    }
+    if (sysfsRoot()[0] != '\0' && NULL == realpath(sysfsRoot(), root)) {
+        return 0;
+    }
+    if (glob(resolved, 0, NULL, &matches) != 0) {
+        return 0;
+    }
+    size_t rootLength = strlen(root);
+    for (size_t i = 0; i < matches.gl_pathc; i++) {
+        char canonical[PATH_MAX];
+        if (NULL == realpath(matches.gl_pathv[i], canonical) ||
+            strncmp(canonical, root, rootLength) != 0) {
+            continue;
+        }
+        callback(canonical + rootLength, context);
+        count++;
+    }
+    globfree(&matches);
+    return count;
+}
+
+/**
+ * @brief Get the CLOCK_MONOTONIC time in microseconds.
+ * @return The current monotonic time.
+*/
+uint64_t monotonicTimeUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/**
+ * @brief Get the CLOCK_MONOTONIC time in milliseconds.
+ * @return The current monotonic time.
+*/
+uint64_t monotonicTimeMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
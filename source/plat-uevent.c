@@ -0,0 +1,139 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Kernel device events. A NETLINK_KOBJECT_UEVENT socket is watched by the
+ * worker's event loop, so a USB device plugged in while a standby state is
+ * applied gets that state's autosuspend policy right away instead of on the
+ * next transition. Only messages sent by the kernel itself are trusted.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include "plat-power-priv.h"
+
+#define UEVENT_BUFFER_SIZE      4096
+#define UEVENT_KERNEL_GROUP     1
+
+/* Only touched by the worker thread, or before it is started. */
+static int uevent_fd = -1;
+static char uevent_buffer[UEVENT_BUFFER_SIZE];
+
+/**
+ * @brief Find a KEY=value field in a uevent message.
+ * @return The value, or NULL if the message has no such field.
+*/
+static const char *ueventField(const char *message, size_t length, const char *key)
+{
+    size_t keyLength = strlen(key);
+    /* "<action>@<devpath>" comes first, then NUL separated KEY=value pairs. */
+    for (size_t offset = strlen(message) + 1; offset < length; offset += strlen(message + offset) + 1) {
+        if (strncmp(message + offset, key, keyLength) == 0 && message[offset + keyLength] == '=') {
+            return message + offset + keyLength + 1;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Open the uevent socket.
+ * Must be called before the worker thread is started.
+*/
+void powerUeventInit(void)
+{
+    struct sockaddr_nl address;
+    uevent_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (uevent_fd < 0) {
+        PWRMGR_LOG_ERRNO("Failed to open uevent socket, device events disabled");
+        return;
+    }
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = UEVENT_KERNEL_GROUP;
+    if (bind(uevent_fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to bind uevent socket, device events disabled");
+        close(uevent_fd);
+        uevent_fd = -1;
+    }
+}
+
+/**
+ * @brief Get the fd the event loop waits on, -1 if device events are disabled.
+*/
+int powerUeventFd(void)
+{
+    return uevent_fd;
+}
+
+/**
+ * @brief Event loop handler: apply the current state to newly added devices.
+ * @param state The power state currently applied by the worker.
+*/
+void powerUeventService(PWRMgr_PowerState_t state)
+{
+    struct sockaddr_nl sender;
+    bool usbAdded = false;
+    while (1) {
+        struct iovec iov = { uevent_buffer, sizeof(uevent_buffer) - 1 };
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_name = &sender;
+        message.msg_namelen = sizeof(sender);
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        ssize_t length = recvmsg(uevent_fd, &message, 0);
+        if (length < 0) {
+            if (EAGAIN != errno && EINTR != errno) {
+                PWRMGR_LOG_ERRNO("Failed to read uevent");
+            }
+            break;
+        }
+        if (0 != sender.nl_pid || (message.msg_flags & MSG_TRUNC)) {
+            continue;
+        }
+        uevent_buffer[length] = '\0';
+        const char *action = ueventField(uevent_buffer, (size_t)length, "ACTION");
+        const char *subsystem = ueventField(uevent_buffer, (size_t)length, "SUBSYSTEM");
+        const char *devtype = ueventField(uevent_buffer, (size_t)length, "DEVTYPE");
+        if (NULL != action && NULL != subsystem && NULL != devtype && strcmp(action, "add") == 0 &&
+            strcmp(subsystem, "usb") == 0 && strcmp(devtype, "usb_device") == 0) {
+            usbAdded = true;
+        }
+    }
+    if (usbAdded) {
+        PWRMGR_LOG_INFO("USB device added in '%s'", rdkPowerStateToString(state));
+        powerUsbApply(state, state);
+        powerShadowCommit();
+    }
+}
+
+/**
+ * @brief Close the uevent socket.
+ * Must be called after the worker thread has been joined.
+*/
+void powerUeventTerm(void)
+{
+    if (uevent_fd >= 0) {
+        close(uevent_fd);
+        uevent_fd = -1;
+    }
+}
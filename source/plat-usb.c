@@ -0,0 +1,227 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * USB runtime autosuspend. States with a usbAutosuspendDelayMs switch the
+ * managed USB devices to power/control "auto" with that delay; the other
+ * states restore the values found when the device was first seen. A device
+ * is managed unless its vendor:product is on powerUsbDenyList, it is missing
+ * from a non-empty powerUsbAllowList, or it is armed as a wakeup source and
+ * not explicitly allowed. Devices plugged in later are picked up on the next
+ * transition.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <libgen.h>
+#include <pthread.h>
+
+#include "plat-power-priv.h"
+
+#define USB_VALUE_MAX           16
+
+typedef struct {
+    char path[PWRMGR_PATH_MAX];     ///< Device directory
+    char name[16];                  ///< Kernel name, e.g. "1-1.3"
+    char id[10];                    ///< vendor:product
+    char baselineControl[USB_VALUE_MAX];
+    long baselineDelayMs;
+    bool managed;
+    bool autosuspend;               ///< Policy currently applied
+} UsbDevice_t;
+
+/* Devices are only modified under usb_mutex. */
+static pthread_mutex_t usb_mutex = PTHREAD_MUTEX_INITIALIZER;
+static UsbDevice_t usb_devices[PWRMGR_USB_MAX_DEVICES];
+static int usb_device_count = 0;
+
+static bool usbListed(const char *const *list, const char *id)
+{
+    for (; NULL != *list; list++) {
+        if (strcmp(*list, id) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void usbDevicePath(const UsbDevice_t *device, const char *attribute, char *path, size_t size)
+{
+    if (snprintf(path, size, "%s/%s", device->path, attribute) >= (int)size) {
+        path[0] = '\0';
+    }
+}
+
+/**
+ * @brief glob callback: register a device from its idVendor attribute.
+ * Call with usb_mutex held.
+*/
+static void usbAddDevice(const char *path, void *context)
+{
+    (void)context;
+    char directory[PWRMGR_PATH_MAX];
+    char attribute[PWRMGR_PATH_MAX];
+    char vendor[8] = {0};
+    char product[8] = {0};
+    char wakeup[USB_VALUE_MAX] = {0};
+    char control[USB_VALUE_MAX] = {0};
+    long delayMs = 0;
+    snprintf(directory, sizeof(directory), "%s", path);
+    const char *devicePath = dirname(directory);
+    for (int i = 0; i < usb_device_count; i++) {
+        if (strcmp(usb_devices[i].path, devicePath) == 0) {
+            return;
+        }
+    }
+    if (usb_device_count == PWRMGR_USB_MAX_DEVICES) {
+        PWRMGR_LOG_WARN("Too many USB devices, ignoring '%s'", devicePath);
+        return;
+    }
+    UsbDevice_t *device = &usb_devices[usb_device_count];
+    snprintf(device->path, sizeof(device->path), "%s", devicePath);
+    usbDevicePath(device, "idProduct", attribute, sizeof(attribute));
+    if (!sysfsReadString(path, vendor, sizeof(vendor)) || !sysfsReadString(attribute, product, sizeof(product))) {
+        return;
+    }
+    usbDevicePath(device, "power/control", attribute, sizeof(attribute));
+    if (!powerShadowReadBaseline(attribute, device->baselineControl, control, sizeof(control))) {
+        return;
+    }
+    usbDevicePath(device, "power/autosuspend_delay_ms", attribute, sizeof(attribute));
+    if (!powerShadowReadBaselineLong(attribute, &device->baselineDelayMs, &delayMs)) {
+        return;
+    }
+    snprintf(device->id, sizeof(device->id), "%.4s:%.4s", vendor, product);
+    snprintf(device->name, sizeof(device->name), "%s", basename(directory));
+    usbDevicePath(device, "power/wakeup", attribute, sizeof(attribute));
+    bool wakeupArmed = sysfsReadString(attribute, wakeup, sizeof(wakeup)) && strcmp(wakeup, "enabled") == 0;
+    bool allowed = usbListed(powerUsbAllowList, device->id);
+    device->managed = !usbListed(powerUsbDenyList, device->id) &&
+                      (allowed || (NULL == powerUsbAllowList[0] && !wakeupArmed));
+    /* Left applied by a previous instance if it differs from the shadowed baseline. */
+    device->autosuspend = strcmp(control, device->baselineControl) != 0 || delayMs != device->baselineDelayMs;
+    usb_device_count++;
+    PWRMGR_LOG_INFO("%s '%s' %s", device->id, device->path, device->managed ? "managed" : "left alone");
+}
+
+/**
+ * @brief Apply or restore the autosuspend policy of one device.
+ * @return true if successful.
+*/
+static bool usbApplyDevice(UsbDevice_t *device, uint32_t delayMs)
+{
+    char attribute[PWRMGR_PATH_MAX];
+    bool autosuspend = device->managed && delayMs > 0;
+    if (!autosuspend && !device->autosuspend) {
+        return true;
+    }
+    /* The delay goes first so a device switched to "auto" never sees the old one. */
+    usbDevicePath(device, "power/autosuspend_delay_ms", attribute, sizeof(attribute));
+    bool success = sysfsWriteLong(attribute, autosuspend ? (long)delayMs : device->baselineDelayMs);
+    usbDevicePath(device, "power/control", attribute, sizeof(attribute));
+    success = sysfsWriteString(attribute, autosuspend ? "auto" : device->baselineControl) && success;
+    if (success) {
+        device->autosuspend = autosuspend;
+    } else {
+        PWRMGR_LOG_ERROR("Failed to update %s '%s'", device->id, device->path);
+    }
+    return success;
+}
+
+/**
+ * @brief Discover the USB devices and snapshot their runtime PM settings.
+ * Must be called before the worker thread is started.
+*/
+void powerUsbInit(void)
+{
+    pthread_mutex_lock(&usb_mutex);
+    usb_device_count = 0;
+    sysfsGlob("/sys/bus/usb/devices/*/idVendor", usbAddDevice, NULL);
+    pthread_mutex_unlock(&usb_mutex);
+    PWRMGR_LOG_INFO("%d USB devices", usb_device_count);
+}
+
+/**
+ * @brief Worker action: apply the USB autosuspend policy of the target state.
+ * @param from The state being left.
+ * @param to The state being entered.
+ * @return true if every present device was updated.
+*/
+bool powerUsbApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to)
+{
+    (void)from;
+    uint32_t delayMs = powerStatePolicy[to].usbAutosuspendDelayMs;
+    bool success = true;
+    pthread_mutex_lock(&usb_mutex);
+    if (delayMs > 0) {
+        sysfsGlob("/sys/bus/usb/devices/*/idVendor", usbAddDevice, NULL);
+    }
+    for (int i = 0; i < usb_device_count; i++) {
+        success = usbApplyDevice(&usb_devices[i], delayMs) && success;
+    }
+    pthread_mutex_unlock(&usb_mutex);
+    return success;
+}
+
+/**
+ * @brief Restore the runtime PM settings found at discovery.
+ * Must be called after the worker thread has been joined.
+*/
+void powerUsbTerm(void)
+{
+    pthread_mutex_lock(&usb_mutex);
+    for (int i = 0; i < usb_device_count; i++) {
+        usbApplyDevice(&usb_devices[i], 0);
+    }
+    pthread_mutex_unlock(&usb_mutex);
+}
+
+/**
+ * @brief Gets the runtime PM status of the USB devices.
+ * @see plat_power_ext.h
+ */
+pmStatus_t PLAT_API_GetUsbStatus(PWRMgr_UsbStatus_t *status)
+{
+    if (!powerMgrIsInitialized()) {
+        return PWRMGR_NOT_INITIALIZED;
+    }
+    if (NULL == status) {
+        return PWRMGR_INVALID_ARGUMENT;
+    }
+    if (pthread_mutex_lock(&usb_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_GET_FAILURE;
+    }
+    memset(status, 0, sizeof(*status));
+    for (int i = 0; i < usb_device_count; i++) {
+        char attribute[PWRMGR_PATH_MAX];
+        PWRMgr_UsbDeviceStatus_t *entry = &status->devices[status->deviceCount];
+        usbDevicePath(&usb_devices[i], "power/runtime_status", attribute, sizeof(attribute));
+        if (!sysfsReadString(attribute, entry->runtimeStatus, sizeof(entry->runtimeStatus))) {
+            /* Unplugged since it was discovered. */
+            continue;
+        }
+        snprintf(entry->name, sizeof(entry->name), "%s", usb_devices[i].name);
+        snprintf(entry->id, sizeof(entry->id), "%s", usb_devices[i].id);
+        entry->managed = usb_devices[i].managed;
+        entry->autosuspend = usb_devices[i].autosuspend;
+        status->deviceCount++;
+    }
+    pthread_mutex_unlock(&usb_mutex);
+    return PWRMGR_SUCCESS;
+}
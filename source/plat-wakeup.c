@@ -0,0 +1,202 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Wakeup source registry. The power/wakeup nodes of the devices backing each
+ * PWRMGR_WakeupSrcType_t are discovered once at init. The enablement of every
+ * source lives in an atomic bitmask, so a Get is a plain memory read and a Set
+ * only touches sysfs when its bit actually flips. A node shared by several
+ * sources (e.g. a USB HID remote) stays enabled while any of them is enabled.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "plat-power-priv.h"
+
+#define WAKEUP_MAX_NODES 32
+#define USB_HID_INTERFACE_CLASS "03"
+
+typedef struct {
+    char path[PWRMGR_PATH_MAX];     ///< power/wakeup attribute
+    uint32_t sources;               ///< Bitmask of sources backed by this node
+    bool enabled;                   ///< Last value written or read
+} WakeupNode_t;
+
+typedef struct {
+    PWRMGR_WakeupSrcType_t source;
+    const char *pattern;            ///< glob(3) pattern of power/wakeup nodes
+} WakeupPattern_t;
+
+/* Device classes backing each wakeup source on the RPi4. */
+static const WakeupPattern_t wakeupPatterns[] = {
+    { PWRMGR_WAKEUPSRC_IR,          "/sys/class/rc/rc*/device/power/wakeup" },
+    { PWRMGR_WAKEUPSRC_POWER_KEY,   "/sys/bus/platform/devices/gpio*keys*/power/wakeup" },
+    { PWRMGR_WAKEUPSRC_LAN,         "/sys/class/net/eth*/device/power/wakeup" },
+    { PWRMGR_WAKEUPSRC_WIFI,        "/sys/class/net/wlan*/device/power/wakeup" },
+    { PWRMGR_WAKEUPSRC_BLUETOOTH,   "/sys/class/bluetooth/hci*/device/power/wakeup" },
+    { PWRMGR_WAKEUPSRC_TIMER,       "/sys/class/rtc/rtc*/device/power/wakeup" },
+    { PWRMGR_WAKEUPSRC_CEC,         "/sys/class/cec/cec*/device/power/wakeup" },
+};
+
+/* Nodes are only modified at init and under wakeup_mutex. */
+static pthread_mutex_t wakeup_mutex = PTHREAD_MUTEX_INITIALIZER;
+static WakeupNode_t wakeup_nodes[WAKEUP_MAX_NODES];
+static int wakeup_node_count = 0;
+static uint32_t wakeup_supported = 0;
+static atomic_uint wakeup_enabled = 0;
+
+typedef struct {
+    PWRMGR_WakeupSrcType_t source;
+} WakeupDiscovery_t;
+
+static void wakeupAddNode(const char *path, void *context)
+{
+    PWRMGR_WakeupSrcType_t source = ((WakeupDiscovery_t *)context)->source;
+    char value[16] = {0};
+    for (int i = 0; i < wakeup_node_count; i++) {
+        if (strcmp(wakeup_nodes[i].path, path) == 0) {
+            wakeup_nodes[i].sources |= (1U << source);
+            wakeup_supported |= (1U << source);
+            return;
+        }
+    }
+    if (wakeup_node_count == WAKEUP_MAX_NODES || strlen(path) >= PWRMGR_PATH_MAX) {
+        PWRMGR_LOG_WARN("Ignoring '%s'", path);
+        return;
+    }
+    /* Devices without wakeup capability report an empty attribute. */
+    if (!sysfsReadString(path, value, sizeof(value)) || value[0] == '\0') {
+        return;
+    }
+    WakeupNode_t *node = &wakeup_nodes[wakeup_node_count++];
+    snprintf(node->path, sizeof(node->path), "%s", path);
+    node->sources = (1U << source);
+    node->enabled = (strcmp(value, "enabled") == 0);
+    wakeup_supported |= (1U << source);
+}
+
+static void wakeupAddUsbHid(const char *path, void *context)
+{
+    char interfaceClass[8] = {0};
+    char device[PWRMGR_PATH_MAX];
+    char node[PWRMGR_PATH_MAX];
+    if (!sysfsReadString(path, interfaceClass, sizeof(interfaceClass)) ||
+        strcmp(interfaceClass, USB_HID_INTERFACE_CLASS) != 0) {
+        return;
+    }
+    /* .../1-1.3/1-1.3:1.0/bInterfaceClass -> .../1-1.3/power/wakeup */
+    snprintf(device, sizeof(device), "%s", path);
+    char *interfaceDir = dirname(device);
+    char *deviceDir = dirname(interfaceDir);
+    snprintf(node, sizeof(node), "%s/power/wakeup", deviceDir);
+    wakeupAddNode(node, context);
+}
+
+/**
+ * @brief Discover the wakeup nodes and read their current enablement.
+ * Must be called before any wakeup API is served.
+*/
+void powerWakeupInit(void)
+{
+    pthread_mutex_lock(&wakeup_mutex);
+    wakeup_node_count = 0;
+    wakeup_supported = 0;
+    for (size_t i = 0; i < sizeof(wakeupPatterns) / sizeof(wakeupPatterns[0]); i++) {
+        WakeupDiscovery_t discovery = { wakeupPatterns[i].source };
+        sysfsGlob(wakeupPatterns[i].pattern, wakeupAddNode, &discovery);
+    }
+    /* USB HID devices (keyboards, RF remote dongles) can deliver a power key. */
+    WakeupDiscovery_t hid = { PWRMGR_WAKEUPSRC_POWER_KEY };
+    sysfsGlob("/sys/bus/usb/devices/*:*/bInterfaceClass", wakeupAddUsbHid, &hid);
+
+    uint32_t enabled = 0;
+    for (int i = 0; i < wakeup_node_count; i++) {
+        if (wakeup_nodes[i].enabled) {
+            enabled |= wakeup_nodes[i].sources;
+        }
+    }
+    atomic_store(&wakeup_enabled, enabled);
+    pthread_mutex_unlock(&wakeup_mutex);
+    PWRMGR_LOG_INFO("%d wakeup nodes, supported 0x%x enabled 0x%x",
+                     wakeup_node_count, wakeup_supported, enabled);
+}
+
+/**
+ * @brief Check whether a wakeup source is backed by at least one device.
+*/
+bool powerWakeupIsSupported(PWRMGR_WakeupSrcType_t srcType)
+{
+    return (wakeup_supported & (1U << srcType)) != 0;
+}
+
+/**
+ * @brief Check whether a wakeup source is enabled; a single atomic load.
+*/
+bool powerWakeupIsEnabled(PWRMGR_WakeupSrcType_t srcType)
+{
+    return (atomic_load(&wakeup_enabled) & (1U << srcType)) != 0;
+}
+
+/**
+ * @brief Enable or disable a wakeup source.
+ * Only the nodes backing a source whose bit flips are written.
+ * @return PWRMGR_SUCCESS, PWRMGR_OPERATION_NOT_SUPPORTED or PWRMGR_SET_FAILURE.
+*/
+pmStatus_t powerWakeupSet(PWRMGR_WakeupSrcType_t srcType, bool enable)
+{
+    if (!powerWakeupIsSupported(srcType)) {
+        return PWRMGR_OPERATION_NOT_SUPPORTED;
+    }
+    if (powerWakeupIsEnabled(srcType) == enable) {
+        return PWRMGR_SUCCESS;
+    }
+    if (pthread_mutex_lock(&wakeup_mutex) != 0) {
+        PWRMGR_LOG_ERRNO("Failed to lock mutex");
+        return PWRMGR_SET_FAILURE;
+    }
+    pmStatus_t status = PWRMGR_SUCCESS;
+    uint32_t previous = atomic_load(&wakeup_enabled);
+    uint32_t wanted = enable ? (previous | (1U << srcType)) : (previous & ~(1U << srcType));
+    for (int i = 0; i < wakeup_node_count; i++) {
+        WakeupNode_t *node = &wakeup_nodes[i];
+        bool nodeEnabled = (node->sources & wanted) != 0;
+        if (!(node->sources & (1U << srcType)) || node->enabled == nodeEnabled) {
+            continue;
+        }
+        if (sysfsWriteString(node->path, nodeEnabled ? "enabled" : "disabled")) {
+            node->enabled = nodeEnabled;
+        } else {
+            PWRMGR_LOG_ERRNO("Failed to write power/wakeup");
+            status = PWRMGR_SET_FAILURE;
+        }
+    }
+    if (PWRMGR_SUCCESS == status) {
+        atomic_store(&wakeup_enabled, wanted);
+    }
+    pthread_mutex_unlock(&wakeup_mutex);
+
+    if (PWRMGR_WAKEUPSRC_TIMER == srcType && PWRMGR_SUCCESS == status) {
+        /* Arm or clear the RTC alarm to follow the timer source. */
+        powerAlarmSync();
+    }
+    return status;
+}
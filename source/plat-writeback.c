@@ -0,0 +1,151 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * VM writeback tuning. Every /proc/sys/vm knob named by any state of the
+ * policy table is registered at init together with its baseline value. On a
+ * transition each knob moves to the value of the new state, or back to its
+ * baseline if the state does not name it; only knobs whose value changes are
+ * written. The knobs are independent, so a failed write is logged and the
+ * pass carries on.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "plat-power-priv.h"
+
+#define WRITEBACK_MAX_KNOBS     16
+
+typedef struct {
+    char path[PWRMGR_PATH_MAX];
+    long baseline;
+    long applied;
+} WritebackKnob_t;
+
+/* Only touched by the worker thread, or before it is started. */
+static WritebackKnob_t writeback_knobs[WRITEBACK_MAX_KNOBS];
+static int writeback_knob_count = 0;
+
+static void writebackKnobPath(const VmSetting_t *setting, char *path, size_t size)
+{
+    snprintf(path, size, "/proc/sys/vm/%s", setting->file);
+}
+
+static WritebackKnob_t *writebackFindKnob(const char *path)
+{
+    for (int i = 0; i < writeback_knob_count; i++) {
+        if (strcmp(writeback_knobs[i].path, path) == 0) {
+            return &writeback_knobs[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Get the value a state wants for a knob.
+ * @return The configured value, or the baseline if the state does not name the knob.
+*/
+static long writebackTargetValue(const WritebackKnob_t *knob, PWRMgr_PowerState_t state)
+{
+    const VmSetting_t *setting = powerStatePolicy[state].vmSettings;
+    for (; NULL != setting && NULL != setting->file; setting++) {
+        char path[PWRMGR_PATH_MAX];
+        writebackKnobPath(setting, path, sizeof(path));
+        if (strcmp(knob->path, path) == 0) {
+            return setting->value;
+        }
+    }
+    return knob->baseline;
+}
+
+/**
+ * @brief Register every knob of the policy table and snapshot its baseline.
+ * Knobs the kernel does not offer are skipped. Must be called before the worker thread is started.
+*/
+void powerWritebackInit(void)
+{
+    writeback_knob_count = 0;
+    for (int state = 0; state < PWRMGR_POWERSTATE_MAX; state++) {
+        const VmSetting_t *setting = powerStatePolicy[state].vmSettings;
+        for (; NULL != setting && NULL != setting->file; setting++) {
+            char path[PWRMGR_PATH_MAX];
+            writebackKnobPath(setting, path, sizeof(path));
+            if (NULL != writebackFindKnob(path)) {
+                continue;
+            }
+            if (writeback_knob_count == WRITEBACK_MAX_KNOBS) {
+                PWRMGR_LOG_WARN("Too many VM knobs, ignoring '%s'", path);
+                continue;
+            }
+            WritebackKnob_t *knob = &writeback_knobs[writeback_knob_count];
+            if (!powerShadowReadBaselineLong(path, &knob->baseline, &knob->applied)) {
+                PWRMGR_LOG_INFO("'%s' not available, skipping", path);
+                continue;
+            }
+            snprintf(knob->path, sizeof(knob->path), "%s", path);
+            writeback_knob_count++;
+        }
+    }
+    PWRMGR_LOG_INFO("%d VM knobs registered", writeback_knob_count);
+}
+
+/**
+ * @brief Worker action: apply the VM writeback settings of the target state.
+ * @param from The state being left.
+ * @param to The state being entered.
+ * @return true if every changed knob was written.
+*/
+bool powerWritebackApply(PWRMgr_PowerState_t from, PWRMgr_PowerState_t to)
+{
+    (void)from;
+    bool success = true;
+    for (int i = 0; i < writeback_knob_count; i++) {
+        WritebackKnob_t *knob = &writeback_knobs[i];
+        long target = writebackTargetValue(knob, to);
+        if (knob->applied == target) {
+            continue;
+        }
+        if (sysfsWriteLong(knob->path, target)) {
+            knob->applied = target;
+        } else {
+            PWRMGR_LOG_ERRNO("'%s' <- %ld failed", knob->path, target);
+            success = false;
+        }
+    }
+    return success;
+}
+
+/**
+ * @brief Restore every registered knob to its baseline.
+ * Must be called after the worker thread has been joined.
+*/
+void powerWritebackTerm(void)
+{
+    for (int i = 0; i < writeback_knob_count; i++) {
+        WritebackKnob_t *knob = &writeback_knobs[i];
+        if (knob->applied == knob->baseline) {
+            continue;
+        }
+        if (sysfsWriteLong(knob->path, knob->baseline)) {
+            knob->applied = knob->baseline;
+        } else {
+            PWRMGR_LOG_ERRNO("Failed to restore VM knob");
+        }
+    }
+}
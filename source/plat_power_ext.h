@@ -0,0 +1,583 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * @file plat_power_ext.h
+ * @brief RPi specific extensions to the Power Manager HAL interface.
+ *
+ * These APIs are not part of the HALIF specification; they let the middleware
+ * steer the platform power policy beyond the five coarse power states.
+ */
+
+#ifndef __PLAT_POWER_EXT_H__
+#define __PLAT_POWER_EXT_H__
+
+#include <stdint.h>
+#include <time.h>
+#include "plat_power.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Workload hints accepted by PLAT_API_PowerHint().
+ */
+typedef enum {
+    PWRMGR_HINT_APP_LAUNCH = 0,         ///< Short burst while an application starts
+    PWRMGR_HINT_VIDEO_DECODE,           ///< Sustained floor for software decode / playback
+    PWRMGR_HINT_INTERACTION,            ///< User input, keep the UI responsive
+    PWRMGR_HINT_BACKGROUND_MAINTENANCE, ///< Housekeeping that should finish quickly in standby
+    PWRMGR_HINT_MAX
+} PWRMgr_PowerHint_t;
+
+/**
+ * @brief Requests a temporary, workload specific performance boost.
+ *
+ * Every call with a non-zero duration takes one reference on the hint which
+ * expires automatically after durationMs (clamped to the per-hint maximum of
+ * the policy table). The hint stays active while at least one reference is
+ * live. A call with durationMs of 0 drops the reference closest to expiry.
+ *
+ * @param[in] hint        - The workload hint
+ * @param[in] durationMs  - Lifetime of the reference in milliseconds, 0 to release
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT   - Parameter passed to this function is invalid
+ * @retval    PWRMGR_SET_FAILURE        - Failed to update
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_PowerHint(PWRMgr_PowerHint_t hint, uint32_t durationMs);
+
+/**
+ * @brief Constraint classes accepted by the QoS request APIs.
+ */
+typedef enum {
+    PWRMGR_QOS_CPU_FREQ_MIN = 0,    ///< CPU frequency floor in kHz, aggregated to the maximum
+    PWRMGR_QOS_CPU_FREQ_MAX,        ///< CPU frequency cap in kHz, aggregated to the minimum
+    PWRMGR_QOS_CPU_LATENCY,         ///< cpuidle wakeup latency bound in us, aggregated to the minimum
+    PWRMGR_QOS_MAX
+} PWRMgr_QosClass_t;
+
+/** Opaque handle identifying a QoS request. */
+typedef uint32_t PWRMgr_QosHandle_t;
+
+/** Aggregate value reported when a class has no active request. */
+#define PWRMGR_QOS_NO_CONSTRAINT (-1)
+
+/**
+ * @brief Adds a QoS request on behalf of a client.
+ *
+ * The effective constraint of each class is recomputed on every change and
+ * written by the HAL worker only when the aggregate actually changes.
+ *
+ * @param[in]  qosClass  - The constraint class
+ * @param[in]  value     - The requested value (kHz or us, must be non-negative)
+ * @param[out] handle    - Handle to update or remove the request
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT   - Parameter passed to this function is invalid
+ * @retval    PWRMGR_SET_FAILURE        - No free request slot
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ * @see PLAT_API_QosUpdateRequest(), PLAT_API_QosRemoveRequest()
+ */
+pmStatus_t PLAT_API_QosAddRequest(PWRMgr_QosClass_t qosClass, int32_t value, PWRMgr_QosHandle_t *handle);
+
+/**
+ * @brief Changes the value of a QoS request.
+ *
+ * @param[in] handle  - Handle returned by PLAT_API_QosAddRequest()
+ * @param[in] value   - The new value
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT   - Stale handle or invalid value
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_QosUpdateRequest(PWRMgr_QosHandle_t handle, int32_t value);
+
+/**
+ * @brief Removes a QoS request; the handle becomes invalid.
+ *
+ * @param[in] handle  - Handle returned by PLAT_API_QosAddRequest()
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT   - Stale handle
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_QosRemoveRequest(PWRMgr_QosHandle_t handle);
+
+/**
+ * @brief Gets the aggregated value of a QoS class.
+ *
+ * @param[in]  qosClass  - The constraint class
+ * @param[out] value     - The aggregate, PWRMGR_QOS_NO_CONSTRAINT if no request is active
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT   - Parameter passed to this function is invalid
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_QosGetEffective(PWRMgr_QosClass_t qosClass, int32_t *value);
+
+/**
+ * @brief CPU parking statistics reported by PLAT_API_GetCpuHotplugStats().
+ */
+typedef struct {
+    uint32_t onlineMask;        ///< CPUs currently online
+    uint32_t parkCount;         ///< Number of parking passes since PLAT_INIT()
+    uint32_t lastParkUs;        ///< Duration of the last offlining pass
+    uint32_t lastUnparkUs;      ///< Duration of the last parallel re-online pass
+    uint32_t maxCpuUnparkUs;    ///< Slowest single CPU of the last re-online pass
+} PWRMgr_CpuHotplugStats_t;
+
+/**
+ * @brief Gets the CPU parking statistics.
+ *
+ * @param[out] stats  - The statistics
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT   - Parameter passed to this function is invalid
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_GetCpuHotplugStats(PWRMgr_CpuHotplugStats_t *stats);
+
+/** Maximum number of cpuidle states reported by PLAT_API_GetCpuidleStats(). */
+#define PWRMGR_CPUIDLE_MAX_STATES 8
+
+/**
+ * @brief Residency of one cpuidle state, summed over the CPUs exposing it.
+ */
+typedef struct {
+    char name[16];                  ///< Kernel name of the idle state
+    uint64_t usage;                 ///< Number of entries since boot
+    uint64_t timeUs;                ///< Residency since boot
+    uint64_t timeSinceTransitionUs; ///< Residency since the last power state change
+    bool disabled;                  ///< Disabled by the current power state policy
+} PWRMgr_CpuidleStateStats_t;
+
+/**
+ * @brief cpuidle statistics reported by PLAT_API_GetCpuidleStats().
+ */
+typedef struct {
+    uint32_t stateCount;
+    PWRMgr_CpuidleStateStats_t states[PWRMGR_CPUIDLE_MAX_STATES];
+} PWRMgr_CpuidleStats_t;
+
+/**
+ * @brief Gets the cpuidle residency statistics.
+ *
+ * Comparing timeSinceTransitionUs of the deepest state with the time spent
+ * in standby shows whether the platform is actually idling deeply.
+ *
+ * @param[out] stats  - The statistics
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT   - Parameter passed to this function is invalid
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_GetCpuidleStats(PWRMgr_CpuidleStats_t *stats);
+
+/** Identifier of a queued wakeup alarm. */
+typedef uint32_t PWRMgr_WakeupAlarmId_t;
+
+/** Maximum number of wakeup alarms that can be queued. */
+#define PWRMGR_WAKEUP_ALARM_MAX 16
+
+/**
+ * @brief Queues a scheduled wake, e.g. for a nightly maintenance window.
+ *
+ * The earliest queued alarm is programmed into the RTC wakealarm while the
+ * PWRMGR_WAKEUPSRC_TIMER source is enabled. When the alarm expires in light
+ * or deep sleep the HAL itself moves to PWRMGR_POWERSTATE_STANDBY, so
+ * background work can run while the display stays off; moving on to
+ * PWRMGR_POWERSTATE_ON is up to the caller.
+ *
+ * @param[in]  wakeTime  - Wake time in seconds since the epoch (UTC), must be in the future
+ * @param[out] alarmId   - Identifier to cancel the alarm
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT   - Parameter passed to this function is invalid
+ * @retval    PWRMGR_SET_FAILURE        - Queue is full
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ * @see PLAT_API_RemoveWakeupAlarm(), PLAT_API_GetNextWakeupAlarm()
+ */
+pmStatus_t PLAT_API_AddWakeupAlarm(time_t wakeTime, PWRMgr_WakeupAlarmId_t *alarmId);
+
+/**
+ * @brief Cancels a queued wakeup alarm.
+ *
+ * @param[in] alarmId  - Identifier returned by PLAT_API_AddWakeupAlarm()
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT   - Unknown or already expired alarm
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_RemoveWakeupAlarm(PWRMgr_WakeupAlarmId_t alarmId);
+
+/**
+ * @brief Gets the earliest queued wakeup alarm.
+ *
+ * @param[out] wakeTime  - Wake time in seconds since the epoch, 0 if none is queued
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT   - Parameter passed to this function is invalid
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_GetNextWakeupAlarm(time_t *wakeTime);
+
+/**
+ * @brief cgroup freezer statistics reported by PLAT_API_GetFreezerStats().
+ */
+typedef struct {
+    uint32_t frozenCount;       ///< cgroups currently frozen
+    uint32_t freezeCount;       ///< Freeze passes since PLAT_INIT()
+    uint32_t timeoutCount;      ///< cgroups that did not confirm in time
+    uint32_t lastFreezeUs;      ///< Last freeze pass, until every cgroup reported frozen
+    uint32_t lastThawUs;        ///< Last thaw pass, until every cgroup reported thawed
+    uint32_t lastFirstThawUs;   ///< Last thaw pass, until the highest priority cgroup ran again
+} PWRMgr_FreezerStats_t;
+
+/**
+ * @brief Gets the cgroup freezer statistics.
+ *
+ * @param[out] stats  - The statistics
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT   - Parameter passed to this function is invalid
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_GetFreezerStats(PWRMgr_FreezerStats_t *stats);
+
+/**
+ * @brief Configures the automatic standby escalation.
+ *
+ * A box left in PWRMGR_POWERSTATE_STANDBY moves to
+ * PWRMGR_POWERSTATE_STANDBY_LIGHT_SLEEP after lightSleepDelaySec, and from
+ * there to PWRMGR_POWERSTATE_STANDBY_DEEP_SLEEP after deepSleepDelaySec. A
+ * stage with a delay of 0 is skipped; both 0 disables the escalation, which is
+ * the default. Any PLAT_API_SetPowerState() or wakeup cancels the pending
+ * stage, and the idle period restarts from the newly entered state.
+ *
+ * @param[in] lightSleepDelaySec  - Idle period in STANDBY before light sleep
+ * @param[in] deepSleepDelaySec   - Idle period before deep sleep
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_SetStandbyEscalation(uint32_t lightSleepDelaySec, uint32_t deepSleepDelaySec);
+
+/**
+ * @brief Memory housekeeping statistics reported by PLAT_API_GetMemoryStats().
+ */
+typedef struct {
+    uint32_t runCount;              ///< Housekeeping passes since PLAT_INIT()
+    uint32_t overrunCount;          ///< Actions that exceeded their time budget
+    uint64_t lastReclaimedBytes;    ///< Bytes reclaimed from cgroups by the last pass
+    uint32_t lastReclaimUs;         ///< Time spent reclaiming in the last pass
+    uint32_t lastCompactUs;         ///< Time spent compacting in the last pass
+    uint32_t lastDropCachesUs;      ///< Time spent dropping caches in the last pass
+    uint64_t lastAvailableBeforeKb; ///< MemAvailable before the last pass
+    uint64_t lastAvailableAfterKb;  ///< MemAvailable after the last pass
+} PWRMgr_MemoryStats_t;
+
+/**
+ * @brief Gets the memory housekeeping statistics.
+ *
+ * @param[out] stats  - The statistics
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT   - Parameter passed to this function is invalid
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_GetMemoryStats(PWRMgr_MemoryStats_t *stats);
+
+/**
+ * @brief Page cache prefetch statistics reported by PLAT_API_GetPrefetchStats().
+ */
+typedef struct {
+    uint32_t fileCount;                 ///< Files in the last snapshot
+    uint32_t rangeCount;                ///< Resident ranges in the last snapshot
+    uint64_t snapshotBytes;             ///< Bytes resident when the last snapshot was taken
+    uint32_t lastSnapshotUs;            ///< Duration of the last snapshot
+    uint64_t lastPrefetchBytes;         ///< Bytes read ahead by the last prefetch
+    uint32_t lastPrefetchUs;            ///< Duration of the last prefetch
+    uint32_t lastFirstFrameMs;          ///< ON transition to the last PLAT_API_ReportFirstFrame()
+    uint32_t prefetchedResumes;         ///< Reported resumes that were prefetched
+    uint32_t avgFirstFrameMsPrefetched; ///< Mean time to first frame of those
+    uint32_t coldResumes;               ///< Reported resumes without a prefetch
+    uint32_t avgFirstFrameMsCold;       ///< Mean time to first frame of those
+} PWRMgr_PrefetchStats_t;
+
+/**
+ * @brief Enables or disables the page cache prefetch on resume.
+ *
+ * The resident pages of the configured hot files are recorded when the box
+ * leaves PWRMGR_POWERSTATE_ON and read back in, in the background, when it
+ * returns to it. Enabled by default; disabling it allows comparing the cold
+ * and prefetched time to first frame.
+ *
+ * @param[in] enable  - true to prefetch on resume
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_SetPagecachePrefetch(bool enable);
+
+/**
+ * @brief Reports that the UI has rendered its first frame after a resume.
+ *
+ * Only the first report after each transition to PWRMGR_POWERSTATE_ON is counted.
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_ReportFirstFrame(void);
+
+/**
+ * @brief Gets the page cache prefetch statistics.
+ *
+ * @param[out] stats  - The statistics
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT   - Parameter passed to this function is invalid
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_GetPrefetchStats(PWRMgr_PrefetchStats_t *stats);
+
+/**
+ * @brief Suspend-to-idle statistics reported by PLAT_API_GetSuspendStats().
+ */
+typedef struct {
+    uint32_t suspendCount;      ///< Successful s2idle entries since PLAT_INIT()
+    uint32_t failCount;         ///< Entries aborted by a hook or refused by the kernel
+    uint64_t lastSleepUs;       ///< Time spent suspended during the last entry
+    uint32_t lastResumeUs;      ///< Last kernel resume to worker pass completed
+    uint32_t maxResumeUs;       ///< Worst resume latency since PLAT_INIT()
+} PWRMgr_SuspendStats_t;
+
+/**
+ * @brief Gets the suspend-to-idle statistics.
+ *
+ * PWRMGR_POWERSTATE_STANDBY_DEEP_SLEEP enters s2idle only when the HAL is
+ * built with --enable-suspendtoidle and the kernel offers "freeze".
+ *
+ * @param[out] stats  - The statistics
+ *
+ * @return    pmStatus_t                        - Status
+ * @retval    PWRMGR_SUCCESS                    - Success
+ * @retval    PWRMGR_NOT_INITIALIZED            - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT           - Parameter passed to this function is invalid
+ * @retval    PWRMGR_OPERATION_NOT_SUPPORTED    - Suspend-to-idle is not enabled
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_GetSuspendStats(PWRMgr_SuspendStats_t *stats);
+
+/** Maximum number of devices reported by PLAT_API_GetUsbStatus(). */
+#define PWRMGR_USB_MAX_DEVICES 32
+
+/**
+ * @brief Runtime PM status of one USB device.
+ */
+typedef struct {
+    char name[16];                  ///< Kernel name of the device, e.g. "1-1.3"
+    char id[10];                    ///< idVendor:idProduct
+    char runtimeStatus[16];         ///< power/runtime_status: "active", "suspended", ...
+    bool managed;                   ///< Not excluded by the allow and deny lists
+    bool autosuspend;               ///< Autosuspend enabled by the current power state
+} PWRMgr_UsbDeviceStatus_t;
+
+/**
+ * @brief USB runtime PM status reported by PLAT_API_GetUsbStatus().
+ */
+typedef struct {
+    uint32_t deviceCount;
+    PWRMgr_UsbDeviceStatus_t devices[PWRMGR_USB_MAX_DEVICES];
+} PWRMgr_UsbStatus_t;
+
+/**
+ * @brief Gets the runtime PM status of the USB devices.
+ *
+ * Devices armed as a wakeup source are only autosuspended when they are on
+ * the platform allow list, so they keep working as wake sources.
+ *
+ * @param[out] status  - The status of every present device
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT   - Parameter passed to this function is invalid
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_GetUsbStatus(PWRMgr_UsbStatus_t *status);
+
+/**
+ * @brief Enables or disables display blanking in the standby states.
+ *
+ * The standby states power the framebuffers down before any other action
+ * and PWRMGR_POWERSTATE_ON unblanks them after every other action. Enabled
+ * by default; middleware that blanks the display itself can disable it. The
+ * change takes effect on the next power state transition. On a DRM display
+ * the blank only takes effect while no other client, such as the compositor,
+ * holds DRM master; otherwise the framebuffers are left alone and the
+ * compositor has to power the display down itself.
+ *
+ * @param[in] enable  - true to blank the display in the standby states
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_SetDisplayBlanking(bool enable);
+
+/** Number of records kept by the transition journal. */
+#define PWRMGR_JOURNAL_MAX_RECORDS 256
+
+/**
+ * @brief Events recorded in the transition journal.
+ */
+typedef enum {
+    PWRMGR_JOURNAL_INIT = 1,            ///< PLAT_INIT(); the first record after a reboot
+    PWRMGR_JOURNAL_TRANSITION,          ///< Power state change requested through PLAT_API_SetPowerState()
+    PWRMGR_JOURNAL_AUTOMATIC,           ///< Power state change decided by the HAL (escalation, wake alarm)
+    PWRMGR_JOURNAL_RESET,               ///< PLAT_Reset(); the box is about to power off or reboot
+} PWRMgr_JournalKind_t;
+
+/**
+ * @brief One transition journal record.
+ */
+typedef struct {
+    uint32_t sequence;                  ///< Increases by one per record, across reboots
+    uint8_t kind;                       ///< PWRMgr_JournalKind_t
+    uint8_t from;                       ///< PWRMgr_PowerState_t before, PWRMGR_POWERSTATE_MAX if none
+    uint8_t to;                         ///< PWRMgr_PowerState_t after
+    uint8_t success;                    ///< 1 if every step succeeded
+    uint64_t wallTimeMs;                ///< CLOCK_REALTIME when the record was written
+    uint32_t latencyUs;                 ///< Time the transition took
+    uint32_t uptimeSec;                 ///< CLOCK_MONOTONIC when the record was written
+    uint32_t reserved;
+    uint32_t checksum;
+} PWRMgr_JournalRecord_t;
+
+/**
+ * @brief Reads the transition journal.
+ *
+ * The journal survives reboots and crashes, so the records before the
+ * last PWRMGR_JOURNAL_INIT show what the box did before it restarted.
+ * Records torn by a crash are left out.
+ *
+ * @param[out]   records  - Buffer receiving the newest records, oldest first
+ * @param[inout] count    - Capacity of the buffer in, records returned out
+ *
+ * @return    pmStatus_t                        - Status
+ * @retval    PWRMGR_SUCCESS                    - Success
+ * @retval    PWRMGR_NOT_INITIALIZED            - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT           - Parameter passed to this function is invalid
+ * @retval    PWRMGR_OPERATION_NOT_SUPPORTED    - The journal file could not be opened
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_GetJournal(PWRMgr_JournalRecord_t *records, uint32_t *count);
+
+/**
+ * @brief Severity of a HAL log message.
+ */
+typedef enum {
+    PWRMGR_LOGLEVEL_ERROR = 0,          ///< Failures
+    PWRMGR_LOGLEVEL_WARN,               ///< Recoverable conditions, ignored devices
+    PWRMGR_LOGLEVEL_INFO,               ///< Transitions and configuration; the default
+    PWRMGR_LOGLEVEL_DEBUG,              ///< Per-action timings and sysfs reads
+    PWRMGR_LOGLEVEL_MAX
+} PWRMgr_LogLevel_t;
+
+/**
+ * @brief Sets the verbosity of the HAL log.
+ *
+ * Messages are formatted on the calling thread into a lock-free ring and
+ * written to syslog, or to the file named by PWRMGR_LOG_FILE, by a
+ * background thread, so raising the level does not block the callers.
+ * The initial level is taken from PWRMGR_LOG_LEVEL ("error", "warn",
+ * "info", "debug") at PLAT_INIT().
+ *
+ * @param[in] level  - Most verbose level written
+ *
+ * @return    pmStatus_t                - Status
+ * @retval    PWRMGR_SUCCESS            - Success
+ * @retval    PWRMGR_NOT_INITIALIZED    - Module is not initialised
+ * @retval    PWRMGR_INVALID_ARGUMENT   - Parameter passed to this function is invalid
+ *
+ * @pre PLAT_INIT() must be called before calling this API
+ */
+pmStatus_t PLAT_API_SetLogLevel(PWRMgr_LogLevel_t level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PLAT_POWER_EXT_H__ */
@@ -0,0 +1,121 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Wakeup alarm queue against a stand-in /sys/class/rtc/rtc0/wakealarm: the
+ * RTC always carries the earliest alarm while the timer wakeup source is
+ * enabled, and the worker is woken for each new earliest deadline.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "test-common.h"
+
+#define WAKEALARM_PATH "/sys/class/rtc/rtc0/wakealarm"
+
+static bool timer_enabled = true;
+static int worker_wakes = 0;
+
+bool powerWakeupIsEnabled(PWRMGR_WakeupSrcType_t srcType)
+{
+    return PWRMGR_WAKEUPSRC_TIMER == srcType && timer_enabled;
+}
+
+bool powerMgrWakeWorker(void)
+{
+    worker_wakes++;
+    return true;
+}
+
+static long rtcWakealarm(void)
+{
+    char value[32] = {0};
+    TEST_CHECK(testReadFile(WAKEALARM_PATH, value, sizeof(value)));
+    return strtol(value, NULL, 10);
+}
+
+int main(void)
+{
+    PWRMgr_WakeupAlarmId_t first;
+    PWRMgr_WakeupAlarmId_t second;
+    PWRMgr_WakeupAlarmId_t third;
+    time_t next = 0;
+    time_t now = time(NULL);
+
+    testRootCreate();
+    /* Left behind by a previous instance. */
+    testWriteFile(WAKEALARM_PATH, "12345\n");
+    powerAlarmInit();
+    TEST_CHECK(rtcWakealarm() == 0);
+
+    /* Queued out of order, the earliest is programmed and wakes the worker. */
+    TEST_CHECK(PLAT_API_AddWakeupAlarm(now + 3600, &first) == PWRMGR_SUCCESS);
+    TEST_CHECK(rtcWakealarm() == now + 3600);
+    TEST_CHECK(PLAT_API_AddWakeupAlarm(now + 600, &second) == PWRMGR_SUCCESS);
+    TEST_CHECK(rtcWakealarm() == now + 600);
+    TEST_CHECK(PLAT_API_AddWakeupAlarm(now + 7200, &third) == PWRMGR_SUCCESS);
+    TEST_CHECK(rtcWakealarm() == now + 600);
+    TEST_CHECK(worker_wakes == 2);
+    TEST_CHECK(PLAT_API_GetNextWakeupAlarm(&next) == PWRMGR_SUCCESS && next == now + 600);
+    uint64_t deadline = powerAlarmNextDeadline();
+    TEST_CHECK(deadline >= monotonicTimeMs() + 598 * 1000ULL && deadline <= monotonicTimeMs() + 600 * 1000ULL);
+
+    TEST_CHECK(PLAT_API_AddWakeupAlarm(now - 1, &first) == PWRMGR_INVALID_ARGUMENT);
+    TEST_CHECK(PLAT_API_RemoveWakeupAlarm(second) == PWRMGR_SUCCESS);
+    TEST_CHECK(PLAT_API_RemoveWakeupAlarm(second) == PWRMGR_INVALID_ARGUMENT);
+    TEST_CHECK(rtcWakealarm() == now + 3600);
+
+    /* Only an enabled timer source may wake the box. */
+    timer_enabled = false;
+    powerAlarmSync();
+    TEST_CHECK(rtcWakealarm() == 0);
+    timer_enabled = true;
+    powerAlarmSync();
+    TEST_CHECK(rtcWakealarm() == now + 3600);
+
+    /* A pre-wake ahead of the alarms is programmed but not reported to clients. */
+    powerAlarmSetPrewake(now + 300);
+    TEST_CHECK(rtcWakealarm() == now + 300);
+    TEST_CHECK(PLAT_API_GetNextWakeupAlarm(&next) == PWRMGR_SUCCESS && next == now + 3600);
+    powerAlarmSetPrewake(0);
+    TEST_CHECK(rtcWakealarm() == now + 3600);
+
+    /* Expiry pops the alarm and moves the RTC on to the next one. */
+    TEST_CHECK(!powerAlarmExpire());
+    TEST_CHECK(PLAT_API_AddWakeupAlarm(time(NULL) + 1, &second) == PWRMGR_SUCCESS);
+    sleep(2);
+    TEST_CHECK(powerAlarmExpire());
+    TEST_CHECK(rtcWakealarm() == now + 3600);
+
+    int queued = 2;
+    PWRMgr_WakeupAlarmId_t id;
+    while (PLAT_API_AddWakeupAlarm(now + 10000 + queued, &id) == PWRMGR_SUCCESS) {
+        queued++;
+    }
+    TEST_CHECK(queued == PWRMGR_WAKEUP_ALARM_MAX);
+
+    powerAlarmTerm();
+    TEST_CHECK(rtcWakealarm() == 0);
+    TEST_CHECK(PLAT_API_GetNextWakeupAlarm(&next) == PWRMGR_SUCCESS && next == 0);
+
+    testRootRemove();
+    return testResult();
+}
@@ -0,0 +1,108 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+#include "test-common.h"
+
+static int test_failures = 0;
+static char test_root[PWRMGR_PATH_MAX];
+
+void testCheck(bool passed, const char *expr, const char *file, int line)
+{
+    if (!passed) {
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+        test_failures++;
+    }
+}
+
+/**
+ * @brief Get the exit status of the test, as automake expects it.
+*/
+int testResult(void)
+{
+    return (0 == test_failures) ? 0 : 1;
+}
+
+/**
+ * @brief Create an empty kernel interface tree and point PWRMGR_SYSFS_ROOT at it.
+*/
+void testRootCreate(void)
+{
+    const char *tmpdir = getenv("TMPDIR");
+    snprintf(test_root, sizeof(test_root), "%s/pwrmgr-test.XXXXXX", (NULL != tmpdir) ? tmpdir : "/tmp");
+    if (NULL == mkdtemp(test_root)) {
+        perror("mkdtemp");
+        exit(99);
+    }
+    setenv(PWRMGR_SYSFS_ROOT_ENV, test_root, 1);
+}
+
+static int testRemoveEntry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st; (void)flag; (void)ftw;
+    return remove(path);
+}
+
+void testRootRemove(void)
+{
+    nftw(test_root, testRemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+    unsetenv(PWRMGR_SYSFS_ROOT_ENV);
+}
+
+/**
+ * @brief Create a file in the tree, along with its parent directories.
+ * @param path The path as seen on the target.
+*/
+void testWriteFile(const char *path, const char *content)
+{
+    char resolved[PWRMGR_PATH_MAX];
+    snprintf(resolved, sizeof(resolved), "%s%s", test_root, path);
+    for (char *slash = strchr(resolved + strlen(test_root) + 1, '/'); NULL != slash; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        mkdir(resolved, 0755);
+        *slash = '/';
+    }
+    FILE *fp = fopen(resolved, "w");
+    if (NULL == fp) {
+        perror(resolved);
+        exit(99);
+    }
+    fputs(content, fp);
+    fclose(fp);
+}
+
+/**
+ * @brief Read back a file of the tree, trailing newline stripped.
+*/
+bool testReadFile(const char *path, char *content, size_t size)
+{
+    return sysfsReadString(path, content, size);
+}
+
+/* Only the logger asks; the modules under test run without the worker. */
+bool powerMgrIsInitialized(void)
+{
+    return true;
+}
@@ -0,0 +1,43 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Helpers shared by the module tests. Each test runs its module against a
+ * throwaway tree that PWRMGR_SYSFS_ROOT points at, standing in for /sys,
+ * /proc and the boot partition.
+ */
+#ifndef __TEST_COMMON_H__
+#define __TEST_COMMON_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "plat-power-priv.h"
+
+#define TEST_CHECK(expr) testCheck((expr), #expr, __FILE__, __LINE__)
+
+void testCheck(bool passed, const char *expr, const char *file, int line);
+int testResult(void);
+
+void testRootCreate(void);
+void testRootRemove(void);
+void testWriteFile(const char *path, const char *content);
+bool testReadFile(const char *path, char *content, size_t size);
+
+#endif /* __TEST_COMMON_H__ */
@@ -0,0 +1,144 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * kexec reboot with the system calls replaced through powerKexecSetOps():
+ * the boot partition and /proc/cmdline are stand-ins, the load is checked
+ * for the right images and command line, and the reboot path taken is
+ * recorded instead of rebooting.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <linux/kexec.h>
+#include <linux/reboot.h>
+
+#include "test-common.h"
+
+#define KERNEL_PATH     "/boot/firmware/kernel8.img"
+#define INITRD_PATH     "/boot/firmware/initramfs8"
+#define CMDLINE         "console=serial0,115200 root=/dev/mmcblk0p2 rootwait"
+
+static int load_calls = 0;
+static int unload_calls = 0;
+static int reboot_calls = 0;
+static int reboot_cmd = 0;
+static bool load_fails = false;
+static unsigned long load_flags = 0;
+static char load_kernel[16];
+static char load_cmdline[256];
+
+static long fakeKexecFileLoad(int kernelFd, int initrdFd, unsigned long cmdlineLen,
+                              const char *cmdline, unsigned long flags)
+{
+    (void)initrdFd;
+    if (flags & KEXEC_FILE_UNLOAD) {
+        unload_calls++;
+        return 0;
+    }
+    load_calls++;
+    load_flags = flags;
+    memset(load_kernel, 0, sizeof(load_kernel));
+    if (read(kernelFd, load_kernel, sizeof(load_kernel) - 1) < 0) {
+        return -1;
+    }
+    snprintf(load_cmdline, sizeof(load_cmdline), "%s", cmdline);
+    TEST_CHECK(cmdlineLen == strlen(cmdline) + 1);
+    if (load_fails) {
+        errno = ENOEXEC;
+        return -1;
+    }
+    return 0;
+}
+
+/* Returning means the kexec failed, as the real one only returns then. */
+static int fakeReboot(int cmd)
+{
+    reboot_calls++;
+    reboot_cmd = cmd;
+    errno = EINVAL;
+    return -1;
+}
+
+static const PowerKexecOps_t fakeOps = {
+    fakeKexecFileLoad,
+    fakeReboot,
+};
+
+int main(void)
+{
+    testRootCreate();
+    testWriteFile("/proc/cmdline", CMDLINE "\n");
+    testWriteFile(KERNEL_PATH, "kernel-1");
+    testWriteFile(INITRD_PATH, "initrd-1");
+    powerKexecSetOps(&fakeOps);
+
+    /* Preloaded at init with the initrd and the running command line. */
+    powerKexecInit();
+    TEST_CHECK(load_calls == 1);
+    TEST_CHECK(load_flags == 0);
+    TEST_CHECK(strcmp(load_kernel, "kernel-1") == 0);
+    TEST_CHECK(strcmp(load_cmdline, CMDLINE) == 0);
+
+    /* Reset jumps into the preloaded image without loading it again. */
+    TEST_CHECK(!powerKexecReboot());
+    TEST_CHECK(load_calls == 1);
+    TEST_CHECK(reboot_calls == 1 && reboot_cmd == LINUX_REBOOT_CMD_KEXEC);
+
+    /* An upgrade replaced the kernel since init: reload before the jump. */
+    testWriteFile(KERNEL_PATH, "kernel-2-larger");
+    TEST_CHECK(!powerKexecReboot());
+    TEST_CHECK(load_calls == 2);
+    TEST_CHECK(strcmp(load_kernel, "kernel-2-larger") == 0);
+    TEST_CHECK(reboot_calls == 2);
+
+    /* A rejected image falls back to a normal reboot without trying kexec. */
+    testWriteFile(KERNEL_PATH, "kernel-3-broken-image");
+    load_fails = true;
+    TEST_CHECK(!powerKexecReboot());
+    TEST_CHECK(load_calls == 3);
+    TEST_CHECK(reboot_calls == 2);
+    load_fails = false;
+
+    /* Nothing loaded, nothing to unload. */
+    powerKexecTerm();
+    TEST_CHECK(unload_calls == 0);
+
+    /* Without an initrd the kernel is loaded on its own. */
+    testRootRemove();
+    testRootCreate();
+    testWriteFile("/proc/cmdline", CMDLINE "\n");
+    testWriteFile(KERNEL_PATH, "kernel-4");
+    powerKexecInit();
+    TEST_CHECK(load_calls == 4);
+    TEST_CHECK(load_flags == KEXEC_FILE_NO_INITRAMFS);
+    powerKexecTerm();
+    TEST_CHECK(unload_calls == 1);
+
+    /* No kernel on the boot partition: no load, normal reboot. */
+    testRootRemove();
+    testRootCreate();
+    testWriteFile("/proc/cmdline", CMDLINE "\n");
+    TEST_CHECK(!powerKexecReboot());
+    TEST_CHECK(load_calls == 4 && reboot_calls == 2);
+
+    testRootRemove();
+    return testResult();
+}
@@ -0,0 +1,109 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2017 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+/**
+ * Suspend-to-idle against a stand-in /sys/power/state: "freeze" is written
+ * only once every pre-suspend hook succeeded, the post-resume hooks unwind
+ * in reverse, and the statistics count entries, aborts and resume latency.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "test-common.h"
+
+#define POWER_STATE_PATH "/sys/power/state"
+
+static bool voice_enabled = true;
+static bool freezer_fails = false;
+static char hook_trace[64];
+
+bool powerWakeupIsEnabled(PWRMGR_WakeupSrcType_t srcType)
+{
+    return PWRMGR_WAKEUPSRC_VOICE == srcType && voice_enabled;
+}
+
+void powerAlarmSync(void)
+{
+    strcat(hook_trace, "A");
+}
+
+bool powerFreezerSuspend(void)
+{
+    strcat(hook_trace, "F");
+    return !freezer_fails;
+}
+
+void powerFreezerResume(void)
+{
+    strcat(hook_trace, "T");
+}
+
+static bool powerStateIs(const char *expected)
+{
+    char value[64] = {0};
+    return testReadFile(POWER_STATE_PATH, value, sizeof(value)) && strcmp(value, expected) == 0;
+}
+
+int main(void)
+{
+    PWRMgr_SuspendStats_t stats;
+
+    testRootCreate();
+
+    /* The kernel does not offer it: deep sleep stays a governor switch. */
+    testWriteFile(POWER_STATE_PATH, "mem\n");
+    powerSuspendInit();
+    TEST_CHECK(!powerSuspendIsEnabled());
+    TEST_CHECK(PLAT_API_GetSuspendStats(&stats) == PWRMGR_OPERATION_NOT_SUPPORTED);
+
+    testWriteFile(POWER_STATE_PATH, "freeze mem\n");
+    powerSuspendInit();
+    TEST_CHECK(powerSuspendIsEnabled());
+
+    /* Freeze, arm the RTC, suspend, thaw. */
+    TEST_CHECK(powerSuspendToIdle());
+    TEST_CHECK(strcmp(hook_trace, "FAT") == 0);
+    TEST_CHECK(powerStateIs("freeze"));
+    powerSuspendResumeComplete();
+    TEST_CHECK(PLAT_API_GetSuspendStats(&stats) == PWRMGR_SUCCESS);
+    TEST_CHECK(stats.suspendCount == 1 && stats.failCount == 0);
+    TEST_CHECK(stats.maxResumeUs >= stats.lastResumeUs);
+
+    /* Nothing could wake the box: abort after the freeze and thaw again. */
+    hook_trace[0] = '\0';
+    voice_enabled = false;
+    testWriteFile(POWER_STATE_PATH, "freeze mem\n");
+    TEST_CHECK(!powerSuspendToIdle());
+    TEST_CHECK(strcmp(hook_trace, "FT") == 0);
+    TEST_CHECK(powerStateIs("freeze mem"));
+
+    /* A failing first hook has nothing to unwind. */
+    hook_trace[0] = '\0';
+    voice_enabled = true;
+    freezer_fails = true;
+    TEST_CHECK(!powerSuspendToIdle());
+    TEST_CHECK(strcmp(hook_trace, "F") == 0);
+    TEST_CHECK(powerStateIs("freeze mem"));
+
+    TEST_CHECK(PLAT_API_GetSuspendStats(&stats) == PWRMGR_SUCCESS);
+    TEST_CHECK(stats.suspendCount == 1 && stats.failCount == 2);
+
+    testRootRemove();
+    return testResult();
+}